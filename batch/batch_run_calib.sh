@@ -0,0 +1,55 @@
+#!/bin/bash
+
+format='+%Y/%m/%d-%H:%M:%S'
+
+date $format
+
+job_num=$(($SLURM_ARRAY_TASK_ID))
+
+filelist=$lists_dir/$job_num.list
+
+cd $output_dir
+mkdir -p $job_num
+cd $job_num
+
+rm -f list.txt
+while read line; do
+    echo $line >> list.txt
+done < $filelist
+echo >> list.txt
+
+source /etc/profile.d/modules.sh
+module use /cvmfs/it.gsi.de/modulefiles/
+module load compiler/gcc/9
+
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/lustre/nyx/hades/user/mmamaev/install/Flow/lib
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/lustre/nyx/hades/user/mmamaev/install/AnalysisTree/cxx17/lib
+
+echo "loading " $ownroot
+source $ownroot
+
+input_option="--spill-dir ${TMPDIR:-/tmp}"
+if [ -n "$cache_dir" ]; then
+  input_option="--cache-dir $cache_dir"
+fi
+if [ "${SLURM_CPUS_PER_TASK:-1}" -gt 1 ]; then
+  input_option="$input_option --threads $SLURM_CPUS_PER_TASK"
+fi
+if [ -n "$calibration" ]; then
+  input_option="$input_option --calibration $calibration"
+fi
+
+rm -f correction_in.root correction_partial.root
+if [ "$mode" == "partial" ]; then
+  echo "executing $build_dir/correct -i list.txt --partial $input_option"
+  $build_dir/correct -i list.txt --partial $input_option
+else
+  echo "executing $build_dir/correct -i list.txt $input_option"
+  $build_dir/correct -i list.txt $input_option
+  mv correction_out.root correction_in.root
+
+  echo "executing $build_dir/correlate correction_in.root --threads ${SLURM_CPUS_PER_TASK:-1}"
+  $build_dir/correlate correction_in.root --threads ${SLURM_CPUS_PER_TASK:-1}
+fi
+
+echo JOB FINISHED!
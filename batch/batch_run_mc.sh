@@ -12,6 +12,7 @@ cd $output_dir
 mkdir -p $job_num
 cd $job_num
 
+rm -f list.txt
 while read line; do
     echo $line >> list.txt
 done < $filelist
@@ -27,20 +28,25 @@ export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/lustre/nyx/hades/user/mmamaev/install/A
 echo "loading " $ownroot
 source $ownroot
 
-echo "executing $build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root"
-$build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root
-mv correction_out.root correction_in.root
-
-echo "executing $build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root"
-$build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root
-mv correction_out.root correction_in.root
-
-echo "executing $build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root"
-$build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root
-mv correction_out.root correction_in.root
-
-echo "executing $build_dir/mc_correlate correction_out.root"
-$build_dir/mc_correlate correction_in.root
+input_option="--spill-dir ${TMPDIR:-/tmp}"
+if [ -n "$cache_dir" ]; then
+  input_option="--cache-dir $cache_dir"
+fi
+# Only a requeued job resumes, a new submission starts over
+if [ "${SLURM_RESTART_COUNT:-0}" -eq 0 ]; then
+  rm -f checkpoint.txt chunks/*/pass_*.done
+fi
+# Chunks of one file are checkpointed, a requeued job resumes after the last one
+input_option="$input_option --threads ${SLURM_CPUS_PER_TASK:-1} --resume"
+
+echo "executing $build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root --iterations 3 $input_option --perf-json perf_correct.json"
+$build_dir/mc_correct list.txt /lustre/nyx/hades/user/mmamaev/hades_flow/src/param/efficiency_out_new.root --iterations 3 $input_option --perf-json perf_correct.json
+if [ -f correction_out.root ]; then
+  mv correction_out.root correction_in.root
+fi
+
+echo "executing $build_dir/mc_correlate correction_in.root --threads ${SLURM_CPUS_PER_TASK:-1} --perf-json perf_correlate.json"
+$build_dir/mc_correlate correction_in.root --threads ${SLURM_CPUS_PER_TASK:-1} --perf-json perf_correlate.json
 
 echo JOB FINISHED!
 echo
@@ -0,0 +1,98 @@
+#!/bin/bash
+
+# Runs correct and correlate, and with an efficiency file mc_correct and mc_correlate,
+# on synthetic events and prints events/s and peak RSS of every step. The input
+# files depend only on the seeds and are reused, so runs of different builds are
+# comparable; the outputs of each run stay in its own directory.
+# The correlations (means, bootstrap errors and samples, v1 included) of the first run on an
+# input are kept in work_dir/reference and every later run is compared with them,
+# so a change of the results fails the benchmark. Remove the reference after an
+# intended change of the results. The correlations on all cores must equal those on
+# one core exactly: the blocks of events are summed in the same order for any
+# number of threads.
+
+build_dir=$1
+work_dir=$2
+n_files=${3:-4}
+n_events=${4:-25000}
+efficiency=$5
+
+if [ -z "$build_dir" ] || [ -z "$work_dir" ]; then
+  echo "Usage: $0 build_dir work_dir [n_files] [events_per_file] [efficiency.root]"
+  exit 1
+fi
+
+# Inputs and references of an earlier version of generate are not reused
+generator_version=2
+
+mkdir -p $work_dir/input
+work_dir=$(cd $work_dir && pwd)
+build_dir=$(cd $build_dir && pwd)
+
+list=$work_dir/list_v${generator_version}_${n_files}x${n_events}.txt
+rm -f $list
+for seed in $(seq 1 $n_files); do
+  file=$work_dir/input/synthetic_v${generator_version}_${n_events}_${seed}.root
+  if [ ! -f $file ]; then
+    echo "executing $build_dir/generate -o $file -n $n_events -s $seed"
+    $build_dir/generate -o $file -n $n_events -s $seed || exit 1
+  fi
+  echo $file >> $list
+done
+
+run_dir=$work_dir/run_$(date +%Y%m%d_%H%M%S)
+mkdir -p $run_dir/real
+cd $run_dir/real
+echo "executing $build_dir/correct -i $list --iterations 3"
+$build_dir/correct -i $list --iterations 3 --perf-json perf_correct.json || exit 1
+mv correction_out.root correction_in.root
+echo "executing $build_dir/correlate correction_in.root"
+$build_dir/correlate correction_in.root --perf-json perf_correlate.json || exit 1
+# The same correlations with the bootstrap on one and on all cores
+n_cores=$(nproc)
+for threads in 1 $n_cores; do
+  echo "executing $build_dir/correlate correction_in.root --bootstrap 100 --threads $threads"
+  $build_dir/correlate correction_in.root --bootstrap 100 --threads $threads \
+      --output correlation_t${threads}.root --perf-json perf_correlate_t${threads}.json || exit 1
+done
+
+status=0
+mkdir -p $work_dir/reference
+reference=$work_dir/reference/correlation_v${generator_version}_${n_files}x${n_events}.root
+if [ ! -f $reference ]; then
+  cp correlation_t1.root $reference
+  echo "Stored correlation_t1.root as the reference $reference"
+fi
+echo "executing $build_dir/compare $reference correlation_t1.root"
+$build_dir/compare $reference correlation_t1.root || status=1
+echo "executing $build_dir/compare correlation_t1.root correlation_t${n_cores}.root --tolerance 0"
+$build_dir/compare correlation_t1.root correlation_t${n_cores}.root --tolerance 0 || status=1
+
+if [ -n "$efficiency" ]; then
+  mkdir -p $run_dir/mc
+  cd $run_dir/mc
+  echo "executing $build_dir/mc_correct $list $efficiency --iterations 3"
+  $build_dir/mc_correct $list $efficiency --iterations 3 --perf-json perf_correct.json || exit 1
+  mv correction_out.root correction_in.root
+  echo "executing $build_dir/mc_correlate correction_in.root"
+  $build_dir/mc_correlate correction_in.root --perf-json perf_correlate.json || exit 1
+fi
+
+echo
+echo "Results in $run_dir"
+for perf in $run_dir/*/perf_*.json; do
+  events_per_s=$(grep -o '"events_per_s": [0-9.e+-]*' $perf | cut -d' ' -f2)
+  peak_rss=$(grep -o '"peak_rss_kb": [0-9]*' $perf | cut -d' ' -f2)
+  printf "%-40s %12s events/s %10s kB peak RSS\n" ${perf#$run_dir/} "$events_per_s" "$peak_rss"
+done
+for threads in 1 $n_cores; do
+  perf=$run_dir/real/perf_correlate_t${threads}.json
+  for stage in "event loop"; do
+    wall=$(grep -o "\"$stage\": {\"wall_s\": [0-9.e+-]*" $perf | grep -o '[0-9.e+-]*$')
+    printf "correlate --threads %-3s %-12s %10s s\n" $threads "$stage" "$wall"
+  done
+done
+if [ $status -ne 0 ]; then
+  echo "The correlations differ from the reference $reference"
+fi
+exit $status
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+output_dir=$1
+file_name=${2:-correction_in.root}
+threads=${3:-8}
+
+build_dir=/lustre/nyx/hades/user/mmamaev/hades_flow/build
+ownroot=${ownroot:-/lustre/nyx/hades/user/mmamaev/install/root-6.18.04/cxx17/bin/thisroot.sh}
+
+source /etc/profile.d/modules.sh
+module use /cvmfs/it.gsi.de/modulefiles/
+module load compiler/gcc/9
+
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/lustre/nyx/hades/user/mmamaev/install/Flow/lib
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/lustre/nyx/hades/user/mmamaev/install/AnalysisTree/cxx17/lib
+
+echo "loading " $ownroot
+source $ownroot
+
+ls -d $output_dir/[0-9]* > $output_dir/merge.list
+
+echo "executing $build_dir/merge -l $output_dir/merge.list -n $file_name -o $output_dir/$file_name -t $threads --work-dir $output_dir/merge_tmp"
+$build_dir/merge -l $output_dir/merge.list -n $file_name -o $output_dir/$file_name -t $threads --work-dir $output_dir/merge_tmp
+
+echo MERGE FINISHED!
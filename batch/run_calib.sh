@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# Calibrates the corrections over all jobs: every round runs one pass per job in
+# the partial mode, the partial statistics are merged into calibration_<round>.root
+# and used by all jobs of the next round. The last round applies the calibration.
+
+file_list=$1
+output_dir=$2
+cache_dir=$3
+rounds=${4:-2}
+
+ownroot=/lustre/nyx/hades/user/mmamaev/install/root-6.18.04/cxx17/bin/thisroot.sh
+# Flow and AnalysisTree libraries of the merge jobs, as in batch_run_calib.sh
+library_path=/lustre/nyx/hades/user/mmamaev/install/Flow/lib:/lustre/nyx/hades/user/mmamaev/install/AnalysisTree/cxx17/lib
+
+current_dir=$(pwd)
+partition=main
+time=8:00:00
+cpus=1
+merge_threads=8
+build_dir=/lustre/nyx/hades/user/mmamaev/hades_flow/build
+
+lists_dir=${output_dir}/lists
+log_dir=${output_dir}/log
+
+mkdir -p $output_dir
+mkdir -p $log_dir
+mkdir -p $lists_dir
+
+csplit -s -f "$lists_dir/" -b %1d.list "$file_list" -k 2 {99}
+rm $lists_dir/0.list
+
+n_runs=$(ls $lists_dir/*.list | wc -l)
+
+job_range=1-$n_runs
+
+echo file list=$file_list
+echo output_dir=$output_dir
+echo log_dir=$log_dir
+echo lists_dir=$lists_dir
+echo cache_dir=$cache_dir
+echo n_runs=$n_runs
+echo job_range=$job_range
+echo rounds=$rounds
+
+seq -f "$output_dir/%g" 1 $n_runs > $output_dir/merge.list
+
+export_list=output_dir=$output_dir,file_list=$file_list,ownroot=$ownroot,lists_dir=$lists_dir,build_dir=$build_dir,cache_dir=$cache_dir
+
+calibration=
+dependency=
+for round in $(seq 1 $rounds); do
+  job_id=$(sbatch --parsable $dependency -J DT_Calib_$round -p $partition -t $time -c $cpus -a $job_range -e ${log_dir}/%A_%a.e -o ${log_dir}/%A_%a.o --export=$export_list,mode=partial,calibration=$calibration batch_run_calib.sh)
+  echo round $round: job $job_id
+  merge_id=$(sbatch --parsable --dependency=afterok:$job_id -J DT_Merge_$round -p $partition -t $time -c $merge_threads -e ${log_dir}/merge_$round.e -o ${log_dir}/merge_$round.o --wrap="source /etc/profile.d/modules.sh && module use /cvmfs/it.gsi.de/modulefiles/ && module load compiler/gcc/9 && export LD_LIBRARY_PATH=\$LD_LIBRARY_PATH:$library_path && source $ownroot && $build_dir/merge -l $output_dir/merge.list -n correction_partial.root -o $output_dir/calibration_$round.root -t $merge_threads --work-dir $output_dir/merge_tmp")
+  echo round $round: merge $merge_id
+  calibration=$output_dir/calibration_$round.root
+  dependency=--dependency=afterok:$merge_id
+done
+
+sbatch $dependency -J DT_Reader -p $partition -t $time -c $cpus -a $job_range -e ${log_dir}/%A_%a.e -o ${log_dir}/%A_%a.o --export=$export_list,mode=apply,calibration=$calibration batch_run_calib.sh
@@ -2,12 +2,14 @@
 
 file_list=$1
 output_dir=$2
+cache_dir=$3
 
 ownroot=/lustre/nyx/hades/user/mmamaev/install/root-6.18.04/cxx17/bin/thisroot.sh
 
 current_dir=$(pwd)
 partition=main
 time=8:00:00
+cpus=1
 build_dir=/lustre/nyx/hades/user/mmamaev/hades_flow/build
 
 lists_dir=${output_dir}/lists
@@ -28,7 +30,8 @@ echo file list=$file_list
 echo output_dir=$output_dir
 echo log_dir=$log_dir
 echo lists_dir=$lists_dir
+echo cache_dir=$cache_dir
 echo n_runs=$n_runs
 echo job_range=$job_range
 
-sbatch -J DT_Reader -p $partition -t $time -a $job_range -e ${log_dir}/%A_%a.e -o ${log_dir}/%A_%a.o --export=output_dir=$output_dir,file_list=$file_list,ownroot=$ownroot,lists_dir=$lists_dir,build_dir=$build_dir batch_run_mc.sh
+sbatch --requeue -J DT_Reader -p $partition -t $time -c $cpus -a $job_range -e ${log_dir}/%A_%a.e -o ${log_dir}/%A_%a.o --export=output_dir=$output_dir,file_list=$file_list,ownroot=$ownroot,lists_dir=$lists_dir,build_dir=$build_dir,cache_dir=$cache_dir batch_run_mc.sh
@@ -6,16 +6,8 @@ rm correction_in.root
 
 export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/home/mikhail/AnalysisTree/install/lib
 
-echo "executing $build_dir/correct ${1}"
-$build_dir/correct ${1}
-mv correction_out.root correction_in.root
-
-echo "executing $build_dir/correct ${1}"
-$build_dir/correct ${1}
-mv correction_out.root correction_in.root
-
-echo "executing $build_dir/correct ${1} "
-$build_dir/correct ${1}
+echo "executing $build_dir/correct -i ${1} --iterations 3"
+$build_dir/correct -i ${1} --iterations 3
 mv correction_out.root correction_in.root
 
 echo "executing $build_dir/correlate correction_out.root"
@@ -0,0 +1,25 @@
+#include "bootstrap.h"
+
+#include <iterator>
+
+#include "hash.h"
+
+namespace HadesFlow {
+
+namespace {
+
+// Cumulative Poisson(1) probabilities of 0..8
+constexpr double kPoissonCdf[] = {0.3678794412, 0.7357588823, 0.9196986029, 0.9810118431, 0.9963401531,
+                                  0.9994058151, 0.9999167588, 0.9999897508, 0.9999988747};
+
+}
+
+unsigned PoissonWeight(uint64_t seed, uint64_t entry, uint64_t sample) {
+  auto u = (Mix(Mix(seed ^ Mix(entry)) + sample) >> 11) * 0x1.0p-53;
+  unsigned k = 0;
+  while( k < std::size(kPoissonCdf) && u >= kPoissonCdf[k] )
+    ++k;
+  return k;
+}
+
+}
@@ -0,0 +1,15 @@
+#ifndef HADES_FLOW_SRC_COMMON_BOOTSTRAP_H_
+#define HADES_FLOW_SRC_COMMON_BOOTSTRAP_H_
+
+#include <cstdint>
+
+namespace HadesFlow {
+
+// Poisson(1) multiplicity of `entry` in bootstrap sample `sample`. Computed from a
+// hash of (seed, entry, sample) instead of a random stream, so the samples do not
+// depend on the order in which the events are read.
+unsigned PoissonWeight(uint64_t seed, uint64_t entry, uint64_t sample);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_BOOTSTRAP_H_
@@ -0,0 +1,48 @@
+#ifndef HADES_FLOW_SRC_COMMON_CHANNELS_H_
+#define HADES_FLOW_SRC_COMMON_CHANNELS_H_
+
+#include <stdexcept>
+#include <string>
+
+#include <AnalysisTree/Configuration.hpp>
+#include <AnalysisTree/Detector.hpp>
+
+namespace HadesFlow {
+
+inline double GetValue(const AnalysisTree::Container& channel, short id, AnalysisTree::Types type) {
+  switch( type ){
+    case AnalysisTree::Types::kFloat:
+      return channel.GetField<float>(id);
+    case AnalysisTree::Types::kInteger:
+      return channel.GetField<int>(id);
+    default:
+      return channel.GetField<bool>(id) ? 1.0 : 0.0;
+  }
+}
+
+// Throws unless fill tasks can add fields to the channels of `type`
+inline void CheckChannelType(AnalysisTree::DetType type, const std::string& branch) {
+  if( type != AnalysisTree::DetType::kTrack && type != AnalysisTree::DetType::kHit &&
+      type != AnalysisTree::DetType::kParticle )
+    throw std::runtime_error(branch + " is not a track, hit or particle branch");
+}
+
+// Calls `function` with the detector of a branch of `type`, as stored in the
+// branch map passed to FillTask::Init().
+template<typename Function>
+void VisitDetector(AnalysisTree::DetType type, void* detector, Function&& function) {
+  switch( type ){
+    case AnalysisTree::DetType::kTrack:
+      function(*static_cast<AnalysisTree::TrackDetector*>(detector));
+      break;
+    case AnalysisTree::DetType::kHit:
+      function(*static_cast<AnalysisTree::HitDetector*>(detector));
+      break;
+    default:
+      function(*static_cast<AnalysisTree::Particles*>(detector));
+  }
+}
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_CHANNELS_H_
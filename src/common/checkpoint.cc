@@ -0,0 +1,44 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace HadesFlow {
+
+Checkpoint ReadCheckpoint(const std::string& path) {
+  Checkpoint checkpoint;
+  std::ifstream in(path);
+  if( !in )
+    return checkpoint;
+  std::string key;
+  std::string value;
+  while( in >> key >> value ){
+    if( key == "passes" )
+      checkpoint.passes = std::stoi(value);
+    else if( key == "moved" )
+      checkpoint.moved = std::stoi(value) != 0;
+    else if( key == "key" )
+      checkpoint.key = std::stoull(value);
+    else
+      throw std::runtime_error("Unknown entry " + key + " in checkpoint " + path);
+  }
+  return checkpoint;
+}
+
+void WriteCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+  const auto tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp);
+    out << "passes " << checkpoint.passes << "\n"
+        << "moved " << checkpoint.moved << "\n"
+        << "key " << checkpoint.key << "\n";
+    out.flush();
+    if( !out )
+      throw std::runtime_error("Cannot write checkpoint " + tmp);
+  }
+  if( std::rename(tmp.c_str(), path.c_str()) != 0 )
+    throw std::runtime_error("Cannot move " + tmp + " to " + path);
+}
+
+}
@@ -0,0 +1,26 @@
+#ifndef HADES_FLOW_SRC_COMMON_CHECKPOINT_H_
+#define HADES_FLOW_SRC_COMMON_CHECKPOINT_H_
+
+#include <cstdint>
+#include <string>
+
+namespace HadesFlow {
+
+// Progress of a multi-pass run. `passes` passes are complete; `moved` tells whether
+// the output of the last complete pass was already moved to correction_in.root.
+// `key` identifies the input and options of the run (see RunPasses()).
+struct Checkpoint {
+  int passes{0};
+  bool moved{true};
+  uint64_t key{0};
+};
+
+// Returns an empty checkpoint if `path` does not exist.
+Checkpoint ReadCheckpoint(const std::string& path);
+
+// Replaces `path` atomically, a killed job leaves either the old or the new state.
+void WriteCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_CHECKPOINT_H_
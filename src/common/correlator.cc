@@ -0,0 +1,354 @@
+#include "correlator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <TFile.h>
+#include <THnD.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+#include <QnTools/DataContainer.hpp>
+#include <QnTools/QVector.hpp>
+
+#include "bootstrap.h"
+
+namespace HadesFlow {
+
+namespace {
+
+// Correction steps in the order they are applied
+const std::vector<std::string> kSteps{"_RESCALED", "_TWIST", "_RECENTERED", "_PLAIN"};
+
+const char* const kComponentNames[] = {"XX", "YY", "XY", "YX"};
+
+std::string FindBranch(TTree& tree, const std::string& qvector) {
+  if( tree.GetBranch(qvector.c_str()) )
+    return qvector;
+  for( const auto& step : kSteps ){
+    if( tree.GetBranch((qvector + step).c_str()) )
+      return qvector + step;
+  }
+  throw std::runtime_error("No branch of Q-vector " + qvector + " in " + tree.GetName());
+}
+
+// Bins of `axes` in the order of the linear index of a Qn::DataContainer, the last
+// axis running fastest; a single bin if there are no axes.
+std::vector<int> AxisBins(const std::vector<Qn::AxisD>& axes) {
+  std::vector<int> bins;
+  for( const auto& axis : axes )
+    bins.push_back(static_cast<int>(axis.size()));
+  return bins;
+}
+
+void SetIndex(size_t linear, const std::vector<int>& bins, int* index) {
+  for( size_t d=bins.size(); d-->0; ){
+    index[d] = static_cast<int>(linear % bins[d]) + 1;
+    linear /= bins[d];
+  }
+}
+
+}
+
+// Every thread reads through its own file
+struct Correlator::Reader {
+  Reader(const std::string& path, const std::string& name, const std::vector<Correlation>& correlations) {
+    file.reset(TFile::Open(path.c_str(), "read"));
+    if( !file || file->IsZombie() )
+      throw std::runtime_error("Cannot open " + path);
+    tree = dynamic_cast<TTree*>(file->Get(name.c_str()));
+    if( !tree )
+      throw std::runtime_error("No tree " + name + " in " + path);
+    // Every Q-vector is read once per event for all correlations
+    for( const auto& correlation : correlations ){
+      qvectors.emplace(correlation.first, nullptr);
+      qvectors.emplace(correlation.second, nullptr);
+    }
+    tree->SetBranchStatus("*", false);
+    for( auto& [qvector_name, qvector] : qvectors ){
+      auto branch = FindBranch(*tree, qvector_name);
+      tree->SetBranchStatus(branch.c_str(), true);
+      tree->SetBranchAddress(branch.c_str(), &qvector);
+    }
+  }
+
+  std::unique_ptr<TFile> file;
+  TTree* tree{nullptr};
+  std::map<std::string, Qn::DataContainerQVector*> qvectors;
+};
+
+Correlator::Correlator(std::string file, std::string tree) :
+    file_(std::move(file)),
+    tree_(std::move(tree)) {}
+
+void Correlator::SetBootstrap(int n_samples, uint64_t seed) {
+  if( n_samples < 0 )
+    throw std::runtime_error("Number of bootstrap samples must not be negative");
+  n_samples_ = n_samples;
+  seed_ = seed;
+}
+
+void Correlator::AddCorrelation(const std::string& first, const std::string& second, Product product,
+                                unsigned harmonic) {
+  correlations_.push_back({first, second, product, harmonic});
+}
+
+void Correlator::Sums::Add(const Sums& other) {
+  if( other.weights.empty() )
+    return;
+  if( weights.empty() ){
+    *this = other;
+    return;
+  }
+  for( size_t k=0; k<kComponents; ++k ){
+    for( size_t i=0; i<values[k].size(); ++i )
+      values[k][i] += other.values[k][i];
+    for( size_t i=0; i<squares[k].size(); ++i )
+      squares[k][i] += other.squares[k][i];
+  }
+  for( size_t i=0; i<weights.size(); ++i )
+    weights[i] += other.weights[i];
+  for( size_t i=0; i<squared_weights.size(); ++i )
+    squared_weights[i] += other.squared_weights[i];
+}
+
+void Correlator::Accumulate(Reader& reader, long long begin, long long end, std::vector<Sums>& sums) const {
+  sums.assign(correlations_.size(), {});
+  const size_t n_columns = n_samples_ + 1;
+  std::vector<double> sample_weights(n_columns, 1.0);
+  for( long long entry=begin; entry<end; ++entry ){
+    reader.tree->GetEntry(entry);
+    for( int sample=0; sample<n_samples_; ++sample )
+      sample_weights[sample] = PoissonWeight(seed_, entry, sample);
+    for( size_t c=0; c<correlations_.size(); ++c ){
+      const auto& correlation = correlations_[c];
+      auto& sum = sums[c];
+      const auto& first = *reader.qvectors.at(correlation.first);
+      const auto& second = *reader.qvectors.at(correlation.second);
+      const bool first_observable = observables_.count(correlation.first) > 0;
+      const bool second_observable = observables_.count(correlation.second) > 0;
+      if( sum.weights.empty() ){
+        sum.first_axes = first.GetAxes();
+        sum.second_axes = second.GetAxes();
+        sum.n_first = first.size();
+        sum.n_second = second.size();
+        const auto n_bins = sum.n_first * sum.n_second;
+        for( size_t k=0; k<kComponents; ++k ){
+          sum.values[k].assign(n_bins * n_columns, 0.0);
+          sum.squares[k].assign(n_bins, 0.0);
+        }
+        sum.weights.assign(n_bins * n_columns, 0.0);
+        sum.squared_weights.assign(n_bins, 0.0);
+      }
+      const auto h = correlation.harmonic;
+      for( size_t i=0; i<sum.n_first; ++i ){
+        const auto& u = first[i];
+        if( non_zero_only_ && u.sumweights() <= 0 )
+          continue;
+        const auto u_weight = first_observable ? u.sumweights() : 1.0;
+        auto u_x = u.x(h);
+        auto u_y = u.y(h);
+        if( correlation.product == Product::kBothEventPlane ){
+          auto norm = std::hypot(u_x, u_y);
+          if( norm <= 0 )
+            continue;
+          u_x /= norm;
+          u_y /= norm;
+        }
+        for( size_t j=0; j<sum.n_second; ++j ){
+          const auto& q = second[j];
+          if( non_zero_only_ && q.sumweights() <= 0 )
+            continue;
+          auto q_x = q.x(h);
+          auto q_y = q.y(h);
+          if( correlation.product != Product::kScalar ){
+            auto norm = std::hypot(q_x, q_y);
+            if( norm <= 0 )
+              continue;
+            q_x /= norm;
+            q_y /= norm;
+          }
+          const auto weight = u_weight * (second_observable ? q.sumweights() : 1.0);
+          const double products[kComponents] = {u_x * q_x, u_y * q_y, u_x * q_y, u_y * q_x};
+          const auto bin = i * sum.n_second + j;
+          const auto offset = bin * n_columns;
+          for( size_t k=0; k<kComponents; ++k ){
+            const auto value = weight * products[k];
+            auto* sum_values = &sum.values[k][offset];
+            for( size_t sample=0; sample<n_columns; ++sample )
+              sum_values[sample] += sample_weights[sample] * value;
+            sum.squares[k][bin] += value * products[k];
+          }
+          auto* sum_weights = &sum.weights[offset];
+          for( size_t sample=0; sample<n_columns; ++sample )
+            sum_weights[sample] += sample_weights[sample] * weight;
+          sum.squared_weights[bin] += weight * weight;
+        }
+      }
+    }
+  }
+}
+
+void Correlator::Run(int n_threads) {
+  sums_.assign(correlations_.size(), {});
+  if( correlations_.empty() )
+    return;
+  const auto n_entries = Reader(file_, tree_, correlations_).tree->GetEntries();
+  const auto n_blocks = (n_entries + kBlockEntries - 1) / kBlockEntries;
+  n_threads = static_cast<int>(std::max<long long>(1, std::min<long long>(n_threads, n_blocks)));
+
+  std::atomic<long long> next_block{0};
+  std::mutex mutex;
+  // Blocks done ahead of the next one to add
+  std::map<long long, std::vector<Sums>> finished;
+  long long next_added = 0;
+  auto work = [&](){
+    Reader reader(file_, tree_, correlations_);
+    std::vector<Sums> sums;
+    for( auto block = next_block++; block < n_blocks; block = next_block++ ){
+      Accumulate(reader, block * kBlockEntries, std::min(n_entries, (block + 1) * kBlockEntries), sums);
+      std::lock_guard<std::mutex> lock(mutex);
+      finished.emplace(block, std::move(sums));
+      for( auto done = finished.find(next_added); done != finished.end(); done = finished.find(next_added) ){
+        for( size_t c=0; c<sums_.size(); ++c )
+          sums_[c].Add(done->second[c]);
+        finished.erase(done);
+        ++next_added;
+      }
+    }
+  };
+  if( n_threads == 1 ){
+    work();
+  } else {
+    ROOT::EnableThreadSafety();
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(n_threads);
+    for( int t=0; t<n_threads; ++t ){
+      threads.emplace_back([&work, &errors, t](){
+        try {
+          work();
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+    for( auto& thread : threads )
+      thread.join();
+    for( const auto& error : errors ){
+      if( error )
+        std::rethrow_exception(error);
+    }
+  }
+  std::cout << "Correlations: " << n_entries << " events in " << n_blocks << " blocks, "
+            << n_samples_ << " bootstrap samples, " << n_threads << " threads" << std::endl;
+}
+
+void Correlator::Write(const std::string& output) const {
+  std::unique_ptr<TFile> file{TFile::Open(output.c_str(), "recreate")};
+  if( !file || file->IsZombie() )
+    throw std::runtime_error("Cannot create " + output);
+  for( size_t c=0; c<correlations_.size() && c<sums_.size(); ++c ){
+    const auto& correlation = correlations_[c];
+    const auto& sums = sums_[c];
+    if( sums.weights.empty() )
+      continue;
+    // Axes of the first Q-vector, then of the second one
+    std::vector<const Qn::AxisD*> axes;
+    std::vector<std::string> axis_names;
+    auto add_axes = [&axes, &axis_names](const std::vector<Qn::AxisD>& qvector_axes, const std::string& qvector){
+      for( const auto& axis : qvector_axes ){
+        axes.push_back(&axis);
+        axis_names.push_back(qvector + "_" + axis.Name());
+      }
+    };
+    add_axes(sums.first_axes, correlation.first);
+    add_axes(sums.second_axes, correlation.second);
+    const auto first_bins = AxisBins(sums.first_axes);
+    const auto second_bins = AxisBins(sums.second_axes);
+    // A correlation of Q-vectors without axes has a single bin; the samples have
+    // one more axis of the sample number
+    const int dimension = std::max<int>(1, axes.size());
+    std::vector<int> n_bins(dimension + 1, 1);
+    std::vector<double> low(dimension + 1, 0.0), high(dimension + 1, 1.0);
+    for( size_t d=0; d<axes.size(); ++d )
+      n_bins[d] = static_cast<int>(axes[d]->size());
+    n_bins[dimension] = std::max(n_samples_, 1);
+    high[dimension] = n_bins[dimension];
+    auto set_axes = [&axes, &axis_names](THnD& histogram){
+      for( size_t d=0; d<axes.size(); ++d ){
+        std::vector<double> edges;
+        for( size_t bin=0; bin<axes[d]->size(); ++bin )
+          edges.push_back(axes[d]->GetLowerBinEdge(bin));
+        edges.push_back(axes[d]->GetUpperBinEdge(axes[d]->size() - 1));
+        histogram.GetAxis(d)->Set(static_cast<int>(axes[d]->size()), edges.data());
+        histogram.GetAxis(d)->SetName(axis_names[d].c_str());
+        histogram.GetAxis(d)->SetTitle(axis_names[d].c_str());
+      }
+    };
+
+    const size_t n_columns = n_samples_ + 1;
+    for( size_t k=0; k<kComponents; ++k ){
+      auto name = correlation.first + "_" + correlation.second + "_" + kComponentNames[k];
+      auto title = correlation.first + "." + correlation.second + " " + kComponentNames[k];
+      THnD mean(name.c_str(), title.c_str(), dimension, n_bins.data(), low.data(), high.data());
+      set_axes(mean);
+      std::unique_ptr<THnD> samples;
+      if( n_samples_ > 0 ){
+        samples = std::make_unique<THnD>((name + "_samples").c_str(), (title + " samples").c_str(),
+                                         dimension + 1, n_bins.data(), low.data(), high.data());
+        set_axes(*samples);
+        samples->GetAxis(dimension)->SetName("sample");
+        samples->GetAxis(dimension)->SetTitle("sample");
+      }
+      std::vector<int> index(dimension + 1, 1);
+      for( size_t bin=0; bin<sums.squared_weights.size(); ++bin ){
+        const auto* sum_values = &sums.values[k][bin * n_columns];
+        const auto* sum_weights = &sums.weights[bin * n_columns];
+        const auto weight = sum_weights[n_samples_];
+        if( weight <= 0 )
+          continue;
+        SetIndex(bin / sums.n_second, first_bins, index.data());
+        SetIndex(bin % sums.n_second, second_bins, index.data() + first_bins.size());
+        const auto value = sum_values[n_samples_] / weight;
+        mean.SetBinContent(index.data(), value);
+        if( n_samples_ == 0 ){
+          const auto variance = std::max(sums.squares[k][bin] / weight - value * value, 0.0);
+          const auto n_effective = weight * weight / sums.squared_weights[bin];
+          mean.SetBinError(index.data(), std::sqrt(variance / n_effective));
+          continue;
+        }
+        double sum_means = 0, sum_squares = 0;
+        int n_filled = 0;
+        for( int sample=0; sample<n_samples_; ++sample ){
+          if( sum_weights[sample] <= 0 )
+            continue;
+          const auto sample_mean = sum_values[sample] / sum_weights[sample];
+          index[dimension] = sample + 1;
+          samples->SetBinContent(index.data(), sample_mean);
+          sum_means += sample_mean;
+          sum_squares += sample_mean * sample_mean;
+          ++n_filled;
+        }
+        if( n_filled > 1 ){
+          const auto average = sum_means / n_filled;
+          const auto variance = (sum_squares - n_filled * average * average) / (n_filled - 1);
+          mean.SetBinError(index.data(), std::sqrt(std::max(variance, 0.0)));
+        }
+      }
+      mean.Write();
+      if( samples )
+        samples->Write();
+    }
+  }
+  file->Close();
+}
+
+}
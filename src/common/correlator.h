@@ -0,0 +1,97 @@
+#ifndef HADES_FLOW_SRC_COMMON_CORRELATOR_H_
+#define HADES_FLOW_SRC_COMMON_CORRELATOR_H_
+
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <QnTools/Axis.hpp>
+
+namespace HadesFlow {
+
+// Normalisation of the Q-vectors in a correlation, as the SCALAR_PRODUCT,
+// u1Q1_EVENT_PLANE and Q1Q1_EVENT_PLANE types of CorrelationTask.
+enum class Product {
+  kScalar,
+  kEventPlane,
+  kBothEventPlane,
+};
+
+// XX, YY, XY and YX components of correlations of the corrected Q-vectors in the
+// tree written by correct. All correlations are computed in one loop over the tree
+// that reads every Q-vector once per event.
+//
+// The entries are read in blocks of kBlockEntries by up to n_threads threads, each
+// through its own file and into its own sums. The sums of the blocks are added in
+// block order, so the result does not depend on the number of threads.
+//
+// As in CorrelationTask, the correlation of an event is weighted with the sum of
+// weights of its observable Q-vectors (Qn::Stats::Weights::OBSERVABLE); reference
+// Q-vectors enter with weight 1. A Q-vector is read from the branch of its name or
+// of its last correction step.
+//
+// With bootstrap samples every event also enters each sample with its
+// PoissonWeight(), in the same loop, at the cost of one weight per sample and one
+// multiply-add per sample, bin and component.
+class Correlator {
+ public:
+  static constexpr long long kBlockEntries = 10000;
+
+  Correlator(std::string file, std::string tree);
+
+  void SetNonZeroOnly(bool non_zero_only) { non_zero_only_ = non_zero_only; }
+  void SetObservable(const std::string& qvector) { observables_.insert(qvector); }
+  void SetBootstrap(int n_samples, uint64_t seed);
+  void AddCorrelation(const std::string& first, const std::string& second, Product product,
+                      unsigned harmonic = 1);
+
+  void Run(int n_threads = 1);
+  // For every correlation and component a THnD of the mean per bin, with the axes
+  // of the first and then of the second Q-vector. Its error is the bootstrap
+  // standard deviation, or without samples the statistical error of the weighted
+  // mean. With samples also a THnD <name>_samples of the mean of every sample,
+  // with an additional last axis of the sample number.
+  void Write(const std::string& output) const;
+
+ private:
+  struct Correlation {
+    std::string first;
+    std::string second;
+    Product product;
+    unsigned harmonic;
+  };
+  static constexpr size_t kComponents = 4;
+  struct Sums {
+    std::vector<Qn::AxisD> first_axes;
+    std::vector<Qn::AxisD> second_axes;
+    size_t n_first{0};
+    size_t n_second{0};
+    // [component][bin][sample], the last sample is the full one
+    std::array<std::vector<double>, kComponents> values;
+    std::vector<double> weights;
+    // [component][bin] of the full sample
+    std::array<std::vector<double>, kComponents> squares;
+    std::vector<double> squared_weights;
+
+    void Add(const Sums& other);
+  };
+  struct Reader;
+
+  // Adds the entries [begin, end) to `sums`, one per correlation
+  void Accumulate(Reader& reader, long long begin, long long end, std::vector<Sums>& sums) const;
+
+  std::string file_;
+  std::string tree_;
+  bool non_zero_only_{false};
+  int n_samples_{0};
+  uint64_t seed_{0};
+  std::set<std::string> observables_;
+  std::vector<Correlation> correlations_;
+  std::vector<Sums> sums_;
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_CORRELATOR_H_
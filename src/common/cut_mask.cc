@@ -0,0 +1,74 @@
+#include "cut_mask.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "channels.h"
+#include "range_mask.h"
+
+namespace HadesFlow {
+
+CutMaskTask::CutMaskTask(std::string branch, std::vector<TrackCut> cuts) :
+    branch_(std::move(branch)) {
+  if( cuts.size() > kMaxCuts )
+    throw std::runtime_error("CutMaskTask: more than " + std::to_string(kMaxCuts) + " cuts on " + branch_);
+  for( auto& cut : cuts ){
+    auto column = std::find_if(columns_.begin(), columns_.end(),
+                               [&cut](const Column& other){ return other.field == cut.field; });
+    if( column == columns_.end() )
+      column = columns_.insert(columns_.end(), {cut.field, -1, AnalysisTree::Types::kFloat, {}});
+    cuts_.push_back({std::move(cut), static_cast<size_t>(column - columns_.begin())});
+  }
+}
+
+void CutMaskTask::Init(std::map<std::string, void*>& branches) {
+  auto branch = branches.find(branch_);
+  if( branch == branches.end() )
+    throw std::runtime_error("CutMaskTask: no branch " + branch_);
+  detector_ = branch->second;
+
+  auto& config = in_config_->GetBranchConfig(branch_);
+  type_ = config.GetType();
+  CheckChannelType(type_, branch_);
+  for( auto& column : columns_ ){
+    column.id = config.GetFieldId(column.field);
+    column.type = config.GetFieldType(column.field);
+  }
+  // Resolved by the following tasks like any other field of the branch
+  config.AddField<int>(kField);
+  mask_id_ = config.GetFieldId(kField);
+  config_ = &config;
+}
+
+template<typename Detector>
+void CutMaskTask::Fill(Detector& detector) {
+  const auto n_channels = detector.GetNumberOfChannels();
+  for( auto& column : columns_ ){
+    column.values.resize(n_channels);
+    for( size_t i=0; i<n_channels; ++i )
+      column.values[i] = GetValue(detector.GetChannel(i), column.id, column.type);
+  }
+  masks_.assign(n_channels, 0);
+  for( size_t bit=0; bit<cuts_.size(); ++bit ){
+    const auto& cut = cuts_[bit];
+    const auto& values = columns_[cut.column].values;
+    if( cut.cut.range ){
+      SetRangeBits(values.data(), n_channels, *cut.cut.range, static_cast<int>(bit), masks_.data());
+      continue;
+    }
+    for( size_t i=0; i<n_channels; ++i )
+      masks_[i] |= static_cast<uint32_t>(cut.cut.function(values[i])) << bit;
+  }
+  for( size_t i=0; i<n_channels; ++i ){
+    auto& channel = detector.GetChannel(i);
+    // Resizes the channel for the added field
+    channel.Init(*config_);
+    channel.SetField(static_cast<int>(masks_[i]), mask_id_);
+  }
+}
+
+void CutMaskTask::Exec() {
+  VisitDetector(type_, detector_, [this](auto& detector){ Fill(detector); });
+}
+
+}
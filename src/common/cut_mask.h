@@ -0,0 +1,61 @@
+#ifndef HADES_FLOW_SRC_COMMON_CUT_MASK_H_
+#define HADES_FLOW_SRC_COMMON_CUT_MASK_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <AnalysisTree/Configuration.hpp>
+#include <AnalysisTree/FillTask.hpp>
+
+#include "cut_plan.h"
+
+namespace HadesFlow {
+
+// Evaluates the distinct cuts of one branch once per channel and stores the result
+// in the int field cut_mask, bit i set if cut i passes. Added before the
+// CorrectionTask, it lets every Q-vector apply a single cut on its bits instead of
+// evaluating its own predicates on the same channels (see CutPlan).
+// The fields of the range cuts are gathered per event into contiguous columns and
+// all channels are checked at once by SetRangeBits(); other cuts are called per
+// channel.
+class CutMaskTask : public AnalysisTree::FillTask {
+ public:
+  static constexpr const char* kField = "cut_mask";
+  static constexpr size_t kMaxCuts = 31;
+
+  CutMaskTask(std::string branch, std::vector<TrackCut> cuts);
+
+  void Init(std::map<std::string, void*>& branches) override;
+  void Exec() override;
+  void Finish() override {}
+
+ private:
+  struct Column {
+    std::string field;
+    short id;
+    AnalysisTree::Types type;
+    std::vector<double> values;
+  };
+  struct Cut {
+    TrackCut cut;
+    size_t column;
+  };
+
+  template<typename Detector>
+  void Fill(Detector& detector);
+
+  std::string branch_;
+  std::vector<Cut> cuts_;
+  std::vector<Column> columns_;
+  std::vector<uint32_t> masks_;
+  short mask_id_{-1};
+  AnalysisTree::DetType type_{AnalysisTree::DetType::kTrack};
+  void* detector_{nullptr};
+  const AnalysisTree::BranchConfig* config_{nullptr};
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_CUT_MASK_H_
@@ -0,0 +1,185 @@
+#include "cut_plan.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "cut_mask.h"
+#include "perf.h"
+
+namespace HadesFlow {
+
+std::string Range::Key() const {
+  std::ostringstream key;
+  key.precision(17);
+  key << (lo_closed ? "[" : "(") << lo << "," << hi << (hi_closed ? "]" : ")");
+  return key.str();
+}
+
+Range Intersect(const Range& first, const Range& second) {
+  Range result = first;
+  if( second.lo > result.lo || (second.lo == result.lo && !second.lo_closed) ){
+    result.lo = second.lo;
+    result.lo_closed = second.lo_closed;
+  }
+  if( second.hi < result.hi || (second.hi == result.hi && !second.hi_closed) ){
+    result.hi = second.hi;
+    result.hi_closed = second.hi_closed;
+  }
+  return result;
+}
+
+namespace {
+
+TrackCut MakeRangeCut(const std::string& branch, const std::string& field,
+                      const Range& range, const std::string& description) {
+  return {branch, field, range.Key(), range, description, range};
+}
+
+}
+
+TrackCut RangeCut(const std::string& branch, const std::string& field,
+                  double lo, double hi, const std::string& description) {
+  return MakeRangeCut(branch, field, {lo, hi, true, true}, description);
+}
+
+TrackCut OpenRangeCut(const std::string& branch, const std::string& field,
+                      double lo, double hi, const std::string& description) {
+  return MakeRangeCut(branch, field, {lo, hi, false, false}, description);
+}
+
+TrackCut EqualsCut(const std::string& branch, const std::string& field,
+                   double expected, const std::string& description, double tolerance) {
+  return MakeRangeCut(branch, field, {expected - tolerance, expected + tolerance, false, false}, description);
+}
+
+std::vector<TrackCut> CutPlan::MergeRanges(const std::vector<TrackCut>& cuts) {
+  std::vector<TrackCut> merged;
+  for( const auto& cut : cuts ){
+    auto same_field = std::find_if(merged.begin(), merged.end(), [&cut](const TrackCut& other){
+      return cut.range && other.range && cut.branch == other.branch && cut.field == other.field;
+    });
+    if( same_field == merged.end() ){
+      merged.push_back(cut);
+      continue;
+    }
+    if( same_field->key == cut.key )
+      continue;
+    auto description = same_field->description + "; " + cut.description;
+    *same_field = MakeRangeCut(cut.branch, cut.field, Intersect(*same_field->range, *cut.range), description);
+  }
+  return merged;
+}
+
+void CutPlan::AddQvector(Qn::QvectorTracksConfig& config, const std::string& branch) {
+  qvectors_.push_back({&config, branch, {}});
+}
+
+void CutPlan::AddCut(const Qn::QvectorTracksConfig& config, const TrackCut& cut) {
+  Find(config).cuts.push_back(cut);
+}
+
+CutPlan::Qvector& CutPlan::Find(const Qn::QvectorTracksConfig& config) {
+  auto qvector = std::find_if(qvectors_.begin(), qvectors_.end(),
+                              [&config](const Qvector& q){ return q.config == &config; });
+  if( qvector == qvectors_.end() )
+    throw std::runtime_error("Q-vector is not added to the cut plan");
+  return *qvector;
+}
+
+bool CutPlan::IsShared(const TrackCut& cut) const {
+  for( const auto& qvector : qvectors_ ){
+    bool touches = qvector.branch == cut.branch;
+    bool has_cut = false;
+    for( const auto& other : qvector.cuts ){
+      touches = touches || other.branch == cut.branch;
+      has_cut = has_cut || (other.branch == cut.branch && other.field == cut.field && other.key == cut.key);
+    }
+    if( touches && !has_cut )
+      return false;
+  }
+  return true;
+}
+
+int CutPlan::MaskBit(const TrackCut& cut) {
+  auto& cuts = masks_[cut.branch];
+  auto same = std::find_if(cuts.begin(), cuts.end(), [&cut](const TrackCut& other){
+    return other.field == cut.field && other.key == cut.key;
+  });
+  if( same != cuts.end() )
+    return static_cast<int>(same - cuts.begin());
+  if( cuts.size() == CutMaskTask::kMaxCuts )
+    throw std::runtime_error("More than " + std::to_string(CutMaskTask::kMaxCuts) + " distinct cuts on " + cut.branch);
+  cuts.push_back(cut);
+  return static_cast<int>(cuts.size()) - 1;
+}
+
+std::vector<Qn::QvectorTracksConfig*> CutPlan::Apply() {
+  std::vector<Qn::QvectorTracksConfig*> configs;
+  for( auto& qvector : qvectors_ ){
+    std::vector<TrackCut> own;
+    for( const auto& cut : qvector.cuts ){
+      if( !IsShared(cut) )
+        own.push_back(cut);
+    }
+    unsigned bits = 0;
+    std::string description;
+    for( const auto& cut : MergeRanges(own) ){
+      if( cut.branch != qvector.branch ){
+        qvector.config->AddCut({AnalysisTree::Variable(cut.branch, cut.field),
+                                Sampled<bool(double)>("cut " + cut.branch + "_" + cut.field, cut.function), cut.description});
+        continue;
+      }
+      bits |= 1u << MaskBit(cut);
+      description += (description.empty() ? "" : "; ") + cut.description;
+    }
+    if( bits != 0 ){
+      qvector.config->AddCut({AnalysisTree::Variable(qvector.branch, CutMaskTask::kField),
+                              Sampled<bool(double)>("cut " + qvector.config->GetName(), [bits](double mask){
+                                return (static_cast<unsigned>(mask) & bits) == bits;
+                              }), description});
+    }
+    configs.push_back(qvector.config);
+  }
+  return configs;
+}
+
+std::vector<AnalysisTree::FillTask*> CutPlan::MakeMaskTasks() const {
+  std::vector<AnalysisTree::FillTask*> tasks;
+  for( const auto& [branch, cuts] : masks_ )
+    tasks.push_back(new CutMaskTask(branch, cuts));
+  return tasks;
+}
+
+AnalysisTree::Cuts* CutPlan::AddSharedCuts(const std::string& branch, AnalysisTree::Cuts* branch_cuts) const {
+  std::vector<TrackCut> shared_cuts;
+  for( const auto& qvector : qvectors_ ){
+    for( const auto& cut : qvector.cuts ){
+      if( cut.branch == branch && IsShared(cut) )
+        shared_cuts.push_back(cut);
+    }
+  }
+  std::vector<AnalysisTree::SimpleCut> shared;
+  std::vector<std::string> keys;
+  for( const auto& cut : MergeRanges(shared_cuts) ){
+    if( std::find(keys.begin(), keys.end(), cut.field + cut.key) != keys.end() )
+      continue;
+    keys.push_back(cut.field + cut.key);
+    shared.emplace_back(AnalysisTree::Variable(cut.branch, cut.field),
+                        Sampled<bool(double)>("branch cut " + cut.branch + "_" + cut.field, cut.function),
+                        cut.description);
+    std::cout << "Cut \"" << cut.description << "\" is shared by all Q-vectors of " << branch
+              << ", applied as a branch cut" << std::endl;
+  }
+  if( shared.empty() )
+    return branch_cuts;
+  if( !branch_cuts )
+    return new AnalysisTree::Cuts(branch, shared);
+  auto* cuts = new AnalysisTree::Cuts(*branch_cuts);
+  for( const auto& cut : shared )
+    cuts->AddCut(cut);
+  return cuts;
+}
+
+}
@@ -0,0 +1,99 @@
+#ifndef HADES_FLOW_SRC_COMMON_CUT_PLAN_H_
+#define HADES_FLOW_SRC_COMMON_CUT_PLAN_H_
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <GlobalConfig.h>
+#include <AnalysisTree/FillTask.hpp>
+#include <AnalysisTree/Variable.hpp>
+
+namespace HadesFlow {
+
+// Interval on a field value. Equality on an integer-valued field (pid, flags) is
+// the open interval of half-width tolerance around the value.
+struct Range {
+  double lo;
+  double hi;
+  bool lo_closed;
+  bool hi_closed;
+
+  bool operator()(double value) const {
+    return (lo_closed ? lo <= value : lo < value) && (hi_closed ? value <= hi : value < hi);
+  }
+  std::string Key() const;
+};
+
+Range Intersect(const Range& first, const Range& second);
+
+// A cut on one field of a branch. Cuts with equal keys select the same tracks and
+// are evaluated only once. Cuts made with RangeCut(), OpenRangeCut() and
+// EqualsCut() carry their range, which lets the plan merge all range cuts on a
+// field into one interval check; other cuts are opaque predicates with a key
+// chosen by the caller.
+struct TrackCut {
+  std::string branch;
+  std::string field;
+  std::string key;
+  std::function<bool(double)> function;
+  std::string description;
+  std::optional<Range> range{};
+};
+
+// lo <= value <= hi
+TrackCut RangeCut(const std::string& branch, const std::string& field,
+                  double lo, double hi, const std::string& description);
+// lo < value < hi
+TrackCut OpenRangeCut(const std::string& branch, const std::string& field,
+                      double lo, double hi, const std::string& description);
+// |value - expected| < tolerance
+TrackCut EqualsCut(const std::string& branch, const std::string& field,
+                   double expected, const std::string& description, double tolerance = 0.1);
+
+// Collects the cuts of all track Q-vectors before they are handed to the
+// GlobalConfig. A cut that every Q-vector touching its branch applies is moved to
+// the branch cuts of the task manager: it is evaluated once per track and the
+// rejected tracks are dropped before any Q-vector loops over them. The remaining
+// cuts of a branch are numbered by distinct key and evaluated once per track by a
+// CutMaskTask; each Q-vector then cuts on the bits of its own cuts in cut_mask.
+// Range cuts on the same field end up as a single interval check, both among the
+// branch cuts and within a Q-vector.
+class CutPlan {
+ public:
+  void AddQvector(Qn::QvectorTracksConfig& config, const std::string& branch);
+  void AddCut(const Qn::QvectorTracksConfig& config, const TrackCut& cut);
+
+  // Adds the per-Q-vector cuts and returns the Q-vectors in the order they were added.
+  std::vector<Qn::QvectorTracksConfig*> Apply();
+  // Tasks filling the masks used by the cuts of Apply(), to be added to the task
+  // manager before the CorrectionTask.
+  std::vector<AnalysisTree::FillTask*> MakeMaskTasks() const;
+  // Returns a new cuts object with the cuts of `branch_cuts`, which may be null,
+  // and the cuts shared on `branch`, or `branch_cuts` itself if there are none.
+  // `branch_cuts` is not modified, it may be shared by all passes of the process.
+  AnalysisTree::Cuts* AddSharedCuts(const std::string& branch, AnalysisTree::Cuts* branch_cuts) const;
+
+ private:
+  struct Qvector {
+    Qn::QvectorTracksConfig* config;
+    std::string branch;
+    std::vector<TrackCut> cuts;
+  };
+
+  Qvector& Find(const Qn::QvectorTracksConfig& config);
+  bool IsShared(const TrackCut& cut) const;
+  // Bit of `cut` in the mask of its branch
+  int MaskBit(const TrackCut& cut);
+  static std::vector<TrackCut> MergeRanges(const std::vector<TrackCut>& cuts);
+
+  std::vector<Qvector> qvectors_;
+  // Distinct per-Q-vector cuts of each branch in the order of their mask bits
+  std::map<std::string, std::vector<TrackCut>> masks_;
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_CUT_PLAN_H_
@@ -0,0 +1,77 @@
+#include "derived_fields.h"
+
+#include <AnalysisTree/EventHeader.hpp>
+
+#include "channels.h"
+
+namespace HadesFlow {
+
+void DerivedFieldsTask::Init(std::map<std::string, void*>& branches) {
+  auto find = [&branches](const std::string& name) {
+    auto branch = branches.find(name);
+    if( branch == branches.end() )
+      throw std::runtime_error("DerivedFieldsTask: no branch " + name);
+    return branch->second;
+  };
+  detector_ = find(branch_);
+  auto& config = in_config_->GetBranchConfig(branch_);
+  type_ = config.GetType();
+  CheckChannelType(type_, branch_);
+
+  for( auto& field : fields_ ){
+    for( auto& input : field.inputs ){
+      if( input.branch == branch_ && input.field == kEventNumber ){
+        input.source = Source::kEventNumber;
+        continue;
+      }
+      if( input.branch == branch_ && input.field == kChannelIndex ){
+        input.source = Source::kChannelIndex;
+        continue;
+      }
+      const auto& input_config = in_config_->GetBranchConfig(input.branch);
+      if( input.branch != branch_ ){
+        if( input_config.GetType() != AnalysisTree::DetType::kEventHeader )
+          throw std::runtime_error("DerivedFieldsTask: " + input.branch + " is neither " + branch_ +
+                                   " nor an event header");
+        input.source = Source::kEvent;
+        input.event = static_cast<AnalysisTree::EventHeader*>(find(input.branch));
+      }
+      input.id = input_config.GetFieldId(input.field);
+      input.type = input_config.GetFieldType(input.field);
+    }
+    // Resolved by the following tasks like any other field of the branch
+    config.AddField<float>(field.name);
+    field.id = config.GetFieldId(field.name);
+  }
+  config_ = &config;
+  event_number_ = 0;
+}
+
+template<typename Detector>
+void DerivedFieldsTask::Fill(Detector& detector) {
+  const auto n_channels = detector.GetNumberOfChannels();
+  for( size_t i=0; i<n_channels; ++i ){
+    auto& channel = detector.GetChannel(i);
+    // Resizes the channel for the added fields
+    channel.Init(*config_);
+    for( auto& field : fields_ ){
+      for( size_t k=0; k<field.inputs.size(); ++k ){
+        const auto& input = field.inputs[k];
+        switch( input.source ){
+          case Source::kChannel: values_[k] = GetValue(channel, input.id, input.type); break;
+          case Source::kEvent: values_[k] = GetValue(*input.event, input.id, input.type); break;
+          case Source::kEventNumber: values_[k] = static_cast<double>(event_number_); break;
+          case Source::kChannelIndex: values_[k] = static_cast<double>(i); break;
+        }
+      }
+      channel.SetField(static_cast<float>(field.function(values_.data())), field.id);
+    }
+  }
+}
+
+void DerivedFieldsTask::Exec() {
+  VisitDetector(type_, detector_, [this](auto& detector){ Fill(detector); });
+  ++event_number_;
+}
+
+}
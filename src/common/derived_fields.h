@@ -0,0 +1,99 @@
+#ifndef HADES_FLOW_SRC_COMMON_DERIVED_FIELDS_H_
+#define HADES_FLOW_SRC_COMMON_DERIVED_FIELDS_H_
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <AnalysisTree/Configuration.hpp>
+#include <AnalysisTree/FillTask.hpp>
+
+#include "event_cache.h"
+
+namespace HadesFlow {
+
+// Computes derived quantities such as y_cm once per channel of a branch and stores
+// them as float fields of it. Added before the CorrectionTask, the axes, weights and
+// cuts read them as plain fields, without the std::vector that AnalysisTree builds
+// for every call of a Variable lambda. Inputs are fields of the branch itself or of
+// an event header branch, or the number of the event and the index of the channel
+// (kEventNumber, kChannelIndex).
+//
+// The fields are float, the only floating point type of an AnalysisTree container.
+// The inputs are float fields already and the function is evaluated in double, so
+// e.g. y_cm and the efficiency are only rounded once to float (~1e-7 relative),
+// far below the bin widths of the axes and the precision of the efficiency maps.
+class DerivedFieldsTask : public AnalysisTree::FillTask {
+ public:
+  // Inputs of the number of the event in the input of the pass, counted from 0, and
+  // of the index of the channel in the branch. Both are the same in every pass over
+  // the same input.
+  inline static const std::string kEventNumber{"@event_number"};
+  inline static const std::string kChannelIndex{"@channel_index"};
+
+  explicit DerivedFieldsTask(std::string branch) : branch_(std::move(branch)) {}
+
+  // Adds the field `name` computed by `function` from std::array<double, N> of the
+  // values of `inputs`. `function` may be mutable (see LastValue).
+  template<size_t N, typename Function>
+  void AddField(const std::string& name, const FieldList& inputs, Function function) {
+    if( inputs.size() != N )
+      throw std::runtime_error("Derived field " + name + " expects " + std::to_string(N) + " inputs");
+    std::vector<Input> field_inputs;
+    for( const auto& [branch, field] : inputs )
+      field_inputs.push_back({branch, field, Source::kChannel, -1, AnalysisTree::Types::kFloat, nullptr});
+    fields_.push_back({name, std::move(field_inputs), -1,
+                       [function](const double* values) mutable {
+                         std::array<double, N> var;
+                         std::copy_n(values, N, var.begin());
+                         return function(var);
+                       }});
+    values_.resize(std::max(values_.size(), N));
+  }
+
+  void Init(std::map<std::string, void*>& branches) override;
+  void Exec() override;
+  void Finish() override {}
+
+ private:
+  enum class Source {
+    kChannel,
+    kEvent,
+    kEventNumber,
+    kChannelIndex,
+  };
+  struct Input {
+    std::string branch;
+    std::string field;
+    Source source;
+    short id;
+    AnalysisTree::Types type;
+    // Set for fields of an event header
+    const AnalysisTree::Container* event;
+  };
+  struct Field {
+    std::string name;
+    std::vector<Input> inputs;
+    short id;
+    std::function<double(const double*)> function;
+  };
+
+  template<typename Detector>
+  void Fill(Detector& detector);
+
+  std::string branch_;
+  std::vector<Field> fields_;
+  std::vector<double> values_;
+  long long event_number_{0};
+  AnalysisTree::DetType type_{AnalysisTree::DetType::kTrack};
+  void* detector_{nullptr};
+  const AnalysisTree::BranchConfig* config_{nullptr};
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_DERIVED_FIELDS_H_
@@ -0,0 +1,69 @@
+#include "efficiency_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace HadesFlow {
+
+EfficiencyTable::EfficiencyTable(Efficiency efficiency, int n_classes, Axis pt_axis, Axis y_axis) :
+    efficiency_(std::move(efficiency)),
+    n_classes_(n_classes),
+    pt_axis_(pt_axis),
+    y_axis_(y_axis),
+    pt_scale_(pt_axis.n_bins / (pt_axis.hi - pt_axis.lo)),
+    y_scale_(y_axis.n_bins / (y_axis.hi - y_axis.lo)) {
+  if( n_classes < 1 || pt_axis.n_bins < 1 || y_axis.n_bins < 1 )
+    throw std::runtime_error("Efficiency table needs at least one bin per axis");
+  weights_.reserve(static_cast<size_t>(n_classes) * pt_axis.n_bins * y_axis.n_bins);
+  for( int c=0; c<n_classes; ++c ){
+    for( int i=0; i<pt_axis.n_bins; ++i ){
+      auto pT = pt_axis.lo + (i + 0.5) / pt_scale_;
+      for( int j=0; j<y_axis.n_bins; ++j ){
+        auto y = y_axis.lo + (j + 0.5) / y_scale_;
+        weights_.push_back(static_cast<float>(Weight(efficiency_(c, pT, y))));
+      }
+    }
+  }
+}
+
+double EfficiencyTable::Weight(double efficiency) {
+  if( efficiency < 0.05 )
+    return 0.0;
+  if( efficiency > 1.0 )
+    return 0.0;
+  return 1.0/efficiency;
+}
+
+double EfficiencyTable::GetWeight(int centrality_class, double pT, double y) const {
+  auto pt_pos = (pT - pt_axis_.lo) * pt_scale_;
+  auto y_pos = (y - y_axis_.lo) * y_scale_;
+  if( centrality_class < 0 || centrality_class >= n_classes_ ||
+      !(pt_pos >= 0.0 && pt_pos < pt_axis_.n_bins) || !(y_pos >= 0.0 && y_pos < y_axis_.n_bins) )
+    return Weight(efficiency_(centrality_class, pT, y));
+  if( interpolate_ )
+    return Interpolate(centrality_class, pt_pos, y_pos);
+  return At(centrality_class, static_cast<int>(pt_pos), static_cast<int>(y_pos));
+}
+
+double EfficiencyTable::Interpolate(int centrality_class, double pt_pos, double y_pos) const {
+  auto pt_bin = static_cast<int>(pt_pos);
+  auto y_bin = static_cast<int>(y_pos);
+  // Positions relative to the centres of the lower neighbouring cells.
+  auto pt_low = std::min(std::max(static_cast<int>(std::floor(pt_pos - 0.5)), 0), pt_axis_.n_bins - 2);
+  auto y_low = std::min(std::max(static_cast<int>(std::floor(y_pos - 0.5)), 0), y_axis_.n_bins - 2);
+  if( pt_low < 0 || y_low < 0 )
+    return At(centrality_class, pt_bin, y_bin);
+  auto w00 = At(centrality_class, pt_low, y_low);
+  auto w01 = At(centrality_class, pt_low, y_low + 1);
+  auto w10 = At(centrality_class, pt_low + 1, y_low);
+  auto w11 = At(centrality_class, pt_low + 1, y_low + 1);
+  if( w00 == 0.0f || w01 == 0.0f || w10 == 0.0f || w11 == 0.0f )
+    return At(centrality_class, pt_bin, y_bin);
+  auto t = std::min(std::max(pt_pos - 0.5 - pt_low, 0.0), 1.0);
+  auto u = std::min(std::max(y_pos - 0.5 - y_low, 0.0), 1.0);
+  return (1 - t) * ((1 - u) * w00 + u * w01) + t * ((1 - u) * w10 + u * w11);
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef HADES_FLOW_SRC_COMMON_EFFICIENCY_TABLE_H_
+#define HADES_FLOW_SRC_COMMON_EFFICIENCY_TABLE_H_
+
+#include <functional>
+#include <vector>
+
+namespace HadesFlow {
+
+// Efficiency weights 1/eff per centrality class on a regular (pT, y_cm) grid,
+// sampled once at the cell centres from an efficiency function such as
+// HadesUtils::Corrections::GetEfficiency. Efficiencies below 0.05 or above 1 give
+// a weight of 0, as in the per-track calculation. The default steps (5 MeV/c,
+// 0.005 in rapidity) divide the binning of the efficiency maps, so nearest-cell
+// lookup reproduces the maps exactly. Points outside the grid are passed to the
+// efficiency function.
+class EfficiencyTable {
+ public:
+  struct Axis {
+    int n_bins;
+    double lo;
+    double hi;
+  };
+  using Efficiency = std::function<double(int, double, double)>;
+
+  EfficiencyTable(Efficiency efficiency, int n_classes,
+                  Axis pt_axis = {400, 0.0, 2.0},
+                  Axis y_axis = {300, -0.75, 0.75});
+
+  // Bilinear interpolation between the cell centres; cells next to a clipped
+  // (zero-weight) cell fall back to the nearest cell.
+  void SetInterpolation(bool interpolate) { interpolate_ = interpolate; }
+
+  double GetWeight(int centrality_class, double pT, double y) const;
+  static double Weight(double efficiency);
+
+ private:
+  float At(int centrality_class, int pt_bin, int y_bin) const {
+    return weights_[(static_cast<size_t>(centrality_class) * pt_axis_.n_bins + pt_bin) * y_axis_.n_bins + y_bin];
+  }
+  double Interpolate(int centrality_class, double pt_pos, double y_pos) const;
+
+  Efficiency efficiency_;
+  int n_classes_;
+  Axis pt_axis_;
+  Axis y_axis_;
+  double pt_scale_;
+  double y_scale_;
+  bool interpolate_{false};
+  std::vector<float> weights_;
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_EFFICIENCY_TABLE_H_
@@ -0,0 +1,112 @@
+#include "event_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <TFile.h>
+#include <TNamed.h>
+
+#include "file_list.h"
+#include "spill.h"
+
+namespace HadesFlow {
+
+namespace {
+
+const int kCacheVersion = 1;
+const char* kKeyName = "hades_flow_cache_key";
+
+std::string MakeKey(const std::vector<std::string>& files, const FieldList& fields) {
+  std::ostringstream key;
+  key << "version " << kCacheVersion << "\n";
+  for( const auto& file : files ){
+    key << "file " << file;
+    struct stat info{};
+    if( stat(file.c_str(), &info) == 0 )
+      key << " " << info.st_size << " " << info.st_mtime;
+    key << "\n";
+  }
+  auto sorted = fields;
+  std::sort(sorted.begin(), sorted.end());
+  for( const auto& field : sorted )
+    key << "field " << field.first << "." << field.second << "\n";
+  return key.str();
+}
+
+std::string Hash(const std::string& key) {
+  uint64_t hash = 14695981039346656037ull;
+  for( unsigned char c : key ){
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  std::ostringstream hex;
+  hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return hex.str();
+}
+
+bool IsValid(const std::string& cache_file, const std::string& key) {
+  if( access(cache_file.c_str(), R_OK) != 0 )
+    return false;
+  std::unique_ptr<TFile> file{TFile::Open(cache_file.c_str(), "read")};
+  if( !file || file->IsZombie() )
+    return false;
+  auto* stored = dynamic_cast<TNamed*>(file->Get(kKeyName));
+  return stored && key == stored->GetTitle();
+}
+
+}
+
+std::vector<std::string> GetBranches(const FieldList& fields) {
+  std::vector<std::string> branches;
+  for( const auto& field : fields ){
+    if( std::find(branches.begin(), branches.end(), field.first) == branches.end() )
+      branches.push_back(field.first);
+  }
+  return branches;
+}
+
+std::string GetEventCache(const std::string& file_list,
+                          const FieldList& fields,
+                          const std::string& cache_dir) {
+  auto files = ReadFileList(file_list);
+  auto key = MakeKey(files, fields);
+  auto prefix = cache_dir + "/hades_flow_cache_" + Hash(key);
+  auto cache_file = prefix + ".root";
+  auto cache_list = prefix + ".list";
+
+  if( IsValid(cache_file, key) ){
+    std::cout << "Using event cache " << cache_file << std::endl;
+  } else {
+    // Array jobs may share a cache directory: build under a private name and
+    // publish it with an atomic rename.
+    auto tmp_file = prefix + "." + std::to_string(getpid()) + ".tmp.root";
+    SpillTree(file_list, "hades_analysis_tree", GetBranches(fields), tmp_file);
+    {
+      std::unique_ptr<TFile> file{TFile::Open(tmp_file.c_str(), "update")};
+      if( !file || file->IsZombie() )
+        throw std::runtime_error("Cannot reopen " + tmp_file);
+      TNamed stored(kKeyName, key.c_str());
+      stored.Write();
+      file->Close();
+    }
+    if( std::rename(tmp_file.c_str(), cache_file.c_str()) != 0 )
+      throw std::runtime_error("Cannot move " + tmp_file + " to " + cache_file);
+  }
+  // The list is shared in the same way, a concurrent job must not read it half written
+  auto tmp_list = prefix + "." + std::to_string(getpid()) + ".tmp.list";
+  WriteFileList(tmp_list, {cache_file});
+  if( std::rename(tmp_list.c_str(), cache_list.c_str()) != 0 )
+    throw std::runtime_error("Cannot move " + tmp_list + " to " + cache_list);
+  return cache_list;
+}
+
+}
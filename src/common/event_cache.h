@@ -0,0 +1,27 @@
+#ifndef HADES_FLOW_SRC_COMMON_EVENT_CACHE_H_
+#define HADES_FLOW_SRC_COMMON_EVENT_CACHE_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace HadesFlow {
+
+// {branch, field}; "*" as a field keeps the whole branch without naming its fields,
+// e.g. for branches only read by the HadesUtils cuts.
+using FieldList = std::vector<std::pair<std::string, std::string>>;
+
+// Persistent cache of the fields used by the correction task. The cache is built
+// once with SpillTree() into `cache_dir` and reused by every later run on the same
+// input. Its key covers the cache format, the input files with their size and
+// modification time and the requested fields, so changing any of them builds a new
+// cache instead of reading a stale one. Returns a file list pointing to the cache.
+std::string GetEventCache(const std::string& file_list,
+                          const FieldList& fields,
+                          const std::string& cache_dir);
+
+std::vector<std::string> GetBranches(const FieldList& fields);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_EVENT_CACHE_H_
@@ -0,0 +1,32 @@
+#include "file_list.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace HadesFlow {
+
+std::vector<std::string> ReadFileList(const std::string& file_list) {
+  std::ifstream in(file_list);
+  if( !in )
+    throw std::runtime_error("Cannot open file list " + file_list);
+  std::vector<std::string> files;
+  std::string line;
+  while( std::getline(in, line) ){
+    auto first = line.find_first_not_of(" \t\r");
+    if( first == std::string::npos )
+      continue;
+    auto last = line.find_last_not_of(" \t\r");
+    files.push_back(line.substr(first, last - first + 1));
+  }
+  return files;
+}
+
+void WriteFileList(const std::string& file_list, const std::vector<std::string>& files) {
+  std::ofstream out(file_list);
+  if( !out )
+    throw std::runtime_error("Cannot write file list " + file_list);
+  for( const auto& file : files )
+    out << file << "\n";
+}
+
+}
@@ -0,0 +1,16 @@
+#ifndef HADES_FLOW_SRC_COMMON_FILE_LIST_H_
+#define HADES_FLOW_SRC_COMMON_FILE_LIST_H_
+
+#include <string>
+#include <vector>
+
+namespace HadesFlow {
+
+// Reads a file list in the format used by the batch scripts: one path per line,
+// empty lines are ignored.
+std::vector<std::string> ReadFileList(const std::string& file_list);
+void WriteFileList(const std::string& file_list, const std::vector<std::string>& files);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_FILE_LIST_H_
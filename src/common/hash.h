@@ -0,0 +1,41 @@
+#ifndef HADES_FLOW_SRC_COMMON_HASH_H_
+#define HADES_FLOW_SRC_COMMON_HASH_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace HadesFlow {
+
+// SplitMix64 finaliser: a counter-based generator, Mix(seed + i) is the i-th
+// random number of a stream without any state to share between threads.
+inline uint64_t Mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Hash of the bit patterns of `values`
+template<size_t N>
+uint64_t Hash(uint64_t seed, const std::array<double, N>& values) {
+  auto hash = Mix(seed);
+  for( auto value : values ){
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    hash = Mix(hash ^ bits);
+  }
+  return hash;
+}
+
+inline uint64_t Hash(uint64_t seed, const std::string& text) {
+  auto hash = Mix(seed);
+  for( auto c : text )
+    hash = Mix(hash ^ static_cast<unsigned char>(c));
+  return hash;
+}
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_HASH_H_
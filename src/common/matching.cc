@@ -0,0 +1,95 @@
+#include "matching.h"
+
+#include <stdexcept>
+
+#include <TChain.h>
+
+namespace HadesFlow {
+
+void MatchingIndex::Build(const AnalysisTree::Matching& matching, size_t n_reco, size_t n_sim) {
+  sim_to_reco_.assign(n_sim, -1);
+  for( const auto& [reco, sim] : matching.GetMatches() ){
+    if( reco < 0 || sim < 0 || static_cast<size_t>(reco) >= n_reco || static_cast<size_t>(sim) >= n_sim )
+      continue;
+    sim_to_reco_[sim] = reco;
+  }
+}
+
+MatchedFieldsTask::MatchedFieldsTask(std::string reco_branch, std::string sim_branch, std::vector<std::string> fields,
+                                     AnalysisTree::Cuts* reco_cuts) :
+    reco_branch_(std::move(reco_branch)),
+    sim_branch_(std::move(sim_branch)),
+    reco_cuts_(reco_cuts) {
+  for( auto& field : fields )
+    fields_.push_back({std::move(field), -1, -1, 0});
+}
+
+void MatchedFieldsTask::Init(std::map<std::string, void*>& branches) {
+  auto find = [&branches](const std::string& name) {
+    auto branch = branches.find(name);
+    if( branch == branches.end() )
+      throw std::runtime_error("MatchedFieldsTask: no branch " + name);
+    return branch->second;
+  };
+  reco_ = static_cast<AnalysisTree::TrackDetector*>(find(reco_branch_));
+  sim_ = static_cast<AnalysisTree::TrackDetector*>(find(sim_branch_));
+  const auto match_name = in_config_->GetMatchName(reco_branch_, sim_branch_);
+  if( branches.count(match_name) ){
+    matching_ = static_cast<AnalysisTree::Matching*>(branches.at(match_name));
+  } else {
+    matching_ = new AnalysisTree::Matching;
+    in_chain_->SetBranchStatus(match_name.c_str(), true);
+    if( in_chain_->SetBranchAddress(match_name.c_str(), &matching_) < 0 )
+      throw std::runtime_error("MatchedFieldsTask: no matching " + match_name);
+  }
+
+  // The new fields are added to the input configuration, so that the following
+  // tasks resolve them like any other field of the sim branch
+  const auto& reco_config = in_config_->GetBranchConfig(reco_branch_);
+  auto& sim_config = in_config_->GetBranchConfig(sim_branch_);
+  for( auto& field : fields_ ){
+    field.reco_id = reco_config.GetFieldId(field.name);
+    field.type = static_cast<int>(reco_config.GetFieldType(field.name));
+    sim_config.AddField<float>("reco_" + field.name);
+    field.sim_id = sim_config.GetFieldId("reco_" + field.name);
+  }
+  sim_config.AddField<float>("is_reco");
+  is_reco_id_ = sim_config.GetFieldId("is_reco");
+  sim_config_ = &sim_config;
+  if( reco_cuts_ )
+    reco_cuts_->Init(*in_config_);
+}
+
+void MatchedFieldsTask::Exec() {
+  const auto n_sim = sim_->GetNumberOfChannels();
+  index_.Build(*matching_, reco_->GetNumberOfChannels(), n_sim);
+  for( size_t i=0; i<n_sim; ++i ){
+    auto& sim = sim_->GetChannel(i);
+    // Makes room for the added fields, the read ones are kept
+    sim.Init(*sim_config_);
+    auto reco_index = index_.GetReco(i);
+    // A partner rejected by the branch cuts does not fill the reco Q-vectors either
+    if( reco_index >= 0 && reco_cuts_ && !reco_cuts_->Apply(reco_->GetChannel(reco_index)) )
+      reco_index = -1;
+    sim.SetField(reco_index >= 0 ? 1.0f : 0.0f, is_reco_id_);
+    for( const auto& field : fields_ ){
+      auto value = kMissing;
+      if( reco_index >= 0 ){
+        const auto& reco = reco_->GetChannel(reco_index);
+        switch( static_cast<AnalysisTree::Types>(field.type) ){
+          case AnalysisTree::Types::kFloat:
+            value = reco.GetField<float>(field.reco_id);
+            break;
+          case AnalysisTree::Types::kInteger:
+            value = static_cast<float>(reco.GetField<int>(field.reco_id));
+            break;
+          default:
+            value = reco.GetField<bool>(field.reco_id) ? 1.0f : 0.0f;
+        }
+      }
+      sim.SetField(value, field.sim_id);
+    }
+  }
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef HADES_FLOW_SRC_COMMON_MATCHING_H_
+#define HADES_FLOW_SRC_COMMON_MATCHING_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <AnalysisTree/Detector.hpp>
+#include <AnalysisTree/FillTask.hpp>
+#include <AnalysisTree/Matching.hpp>
+#include <AnalysisTree/Variable.hpp>
+
+namespace HadesFlow {
+
+// Dense per-event index of a reco-sim matching: the reco partner of every sim
+// track in an array indexed by the channel number, -1 for tracks without one.
+class MatchingIndex {
+ public:
+  void Build(const AnalysisTree::Matching& matching, size_t n_reco, size_t n_sim);
+  int GetReco(size_t sim) const { return sim_to_reco_[sim]; }
+
+ private:
+  std::vector<int> sim_to_reco_;
+};
+
+// Copies `fields` of the matched reco track to every sim track as reco_<field>,
+// together with is_reco (1 if the track was reconstructed and passes `reco_cuts`,
+// the branch cuts of the reco branch, if given). Added before the
+// CorrectionTask, it lets sim Q-vectors cut on and weight with reco quantities
+// through fields of their own branch, without the framework resolving the matching
+// for every track and variable. Fields of unmatched or rejected tracks are kMissing.
+class MatchedFieldsTask : public AnalysisTree::FillTask {
+ public:
+  static constexpr float kMissing = -999.0f;
+
+  MatchedFieldsTask(std::string reco_branch, std::string sim_branch, std::vector<std::string> fields,
+                    AnalysisTree::Cuts* reco_cuts = nullptr);
+
+  void Init(std::map<std::string, void*>& branches) override;
+  void Exec() override;
+  void Finish() override {}
+
+ private:
+  struct Field {
+    std::string name;
+    short reco_id;
+    short sim_id;
+    int type;
+  };
+
+  std::string reco_branch_;
+  std::string sim_branch_;
+  std::vector<Field> fields_;
+  short is_reco_id_{-1};
+  AnalysisTree::Cuts* reco_cuts_{nullptr};
+  AnalysisTree::TrackDetector* reco_{nullptr};
+  AnalysisTree::TrackDetector* sim_{nullptr};
+  AnalysisTree::Matching* matching_{nullptr};
+  const AnalysisTree::BranchConfig* sim_config_{nullptr};
+  MatchingIndex index_;
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_MATCHING_H_
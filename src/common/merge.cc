@@ -0,0 +1,217 @@
+#include "merge.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <TAxis.h>
+#include <TClass.h>
+#include <TDataMember.h>
+#include <TFile.h>
+#include <TFileMerger.h>
+#include <TH1.h>
+#include <TKey.h>
+#include <TTree.h>
+
+#include <QnTools/Axis.hpp>
+
+#include "workers.h"
+
+namespace HadesFlow {
+
+namespace {
+
+std::unique_ptr<TFile> OpenFile(const std::string& path) {
+  std::unique_ptr<TFile> file{TFile::Open(path.c_str(), "read")};
+  if( !file || file->IsZombie() )
+    throw std::runtime_error("Cannot open " + path);
+  return file;
+}
+
+bool SameAxis(const TAxis* first, const TAxis* second) {
+  if( first->GetNbins() != second->GetNbins() )
+    return false;
+  for( int i=1; i<=first->GetNbins()+1; ++i ){
+    if( first->GetBinLowEdge(i) != second->GetBinLowEdge(i) )
+      return false;
+  }
+  return true;
+}
+
+// The merge jobs run inside their own directories
+std::string AbsolutePath(const std::string& path) {
+  if( path.empty() || path.front() == '/' || path.find("://") != std::string::npos )
+    return path;
+  char buffer[PATH_MAX];
+  if( !getcwd(buffer, sizeof(buffer)) )
+    throw std::runtime_error("Cannot get the working directory");
+  return std::string(buffer) + "/" + path;
+}
+
+// Axes of a Qn::DataContainer of any content type, read through its dictionary
+std::vector<Qn::AxisD> QnAxes(TKey* key, TClass* cl) {
+  auto* member = cl->GetDataMember("axes_");
+  if( !member || std::string(member->GetFullTypeName()).find("Qn::Axis<double>") == std::string::npos )
+    throw std::runtime_error(std::string("cannot read the axes of ") + cl->GetName());
+  auto* object = key->ReadObjectAny(cl);
+  if( !object )
+    throw std::runtime_error(std::string("cannot read ") + key->GetName());
+  auto* member_address = static_cast<char*>(object) + cl->GetDataMemberOffset("axes_");
+  auto axes = *reinterpret_cast<std::vector<Qn::AxisD>*>(member_address);
+  cl->Destructor(object);
+  return axes;
+}
+
+bool SameAxes(const std::vector<Qn::AxisD>& first, const std::vector<Qn::AxisD>& second) {
+  if( first.size() != second.size() )
+    return false;
+  for( size_t i=0; i<first.size(); ++i ){
+    if( first[i].Name() != second[i].Name() || first[i].size() != second[i].size() )
+      return false;
+    for( size_t bin=0; bin<first[i].size(); ++bin ){
+      if( first[i].GetLowerBinEdge(bin) != second[i].GetLowerBinEdge(bin) ||
+          first[i].GetUpperBinEdge(bin) != second[i].GetUpperBinEdge(bin) )
+        return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> BranchNames(TTree* tree) {
+  std::vector<std::string> names;
+  TIter next(tree->GetListOfBranches());
+  while( auto* branch = next() )
+    names.emplace_back(branch->GetName());
+  return names;
+}
+
+void CheckDirectory(TDirectory* reference, TDirectory* file, const std::string& path) {
+  auto fail = [&path](const std::string& name, const std::string& what){
+    throw std::runtime_error(path + name + ": " + what);
+  };
+  TIter next(reference->GetListOfKeys());
+  while( auto* key = dynamic_cast<TKey*>(next()) ){
+    std::string name = key->GetName();
+    auto* other = file->GetKey(name.c_str());
+    if( !other )
+      fail(name, "missing");
+    if( std::string(key->GetClassName()) != other->GetClassName() )
+      fail(name, std::string("class ") + other->GetClassName() + " instead of " + key->GetClassName());
+    auto* cl = TClass::GetClass(key->GetClassName());
+    if( !cl )
+      continue;
+    if( cl->InheritsFrom(TDirectory::Class()) ){
+      CheckDirectory(reference->GetDirectory(name.c_str()), file->GetDirectory(name.c_str()), path + name + "/");
+    } else if( cl->InheritsFrom(TH1::Class()) ){
+      std::unique_ptr<TH1> first{dynamic_cast<TH1*>(key->ReadObj())};
+      std::unique_ptr<TH1> second{dynamic_cast<TH1*>(other->ReadObj())};
+      if( !SameAxis(first->GetXaxis(), second->GetXaxis()) ||
+          !SameAxis(first->GetYaxis(), second->GetYaxis()) ||
+          !SameAxis(first->GetZaxis(), second->GetZaxis()) )
+        fail(name, "different binning");
+    } else if( cl->InheritsFrom(TTree::Class()) ){
+      std::unique_ptr<TTree> first{dynamic_cast<TTree*>(key->ReadObj())};
+      std::unique_ptr<TTree> second{dynamic_cast<TTree*>(other->ReadObj())};
+      if( BranchNames(first.get()) != BranchNames(second.get()) )
+        fail(name, "different branches");
+    } else if( std::string(cl->GetName()).rfind("Qn::DataContainer<", 0) == 0 ){
+      if( !SameAxes(QnAxes(key, cl), QnAxes(other, cl)) )
+        fail(name, "different axes");
+    }
+  }
+  if( file->GetListOfKeys()->GetSize() != reference->GetListOfKeys()->GetSize() )
+    fail("", "different number of objects");
+}
+
+}
+
+void MergeFiles(const std::vector<std::string>& inputs, const std::string& output,
+                int max_open, const std::vector<std::string>& skip) {
+  if( inputs.empty() )
+    throw std::runtime_error("Nothing to merge into " + output);
+  TFileMerger merger(false, false);
+  merger.SetMaxOpenedFiles(max_open);
+  if( !merger.OutputFile(output.c_str(), "recreate") )
+    throw std::runtime_error("Cannot create " + output);
+  for( const auto& input : inputs ){
+    if( !merger.AddFile(input.c_str(), false) )
+      throw std::runtime_error("Cannot add " + input + " to " + output);
+  }
+  for( const auto& name : skip )
+    merger.AddObjectNames(name.c_str());
+  auto type = TFileMerger::kAll | TFileMerger::kIncremental;
+  if( !skip.empty() )
+    type |= TFileMerger::kSkipListed;
+  if( !merger.PartialMerge(type) )
+    throw std::runtime_error("Failed to merge into " + output);
+}
+
+void CheckCompatible(const std::string& reference, const std::string& file) {
+  auto first = OpenFile(reference);
+  auto second = OpenFile(file);
+  try {
+    CheckDirectory(first.get(), second.get(), "");
+  } catch (const std::exception& e) {
+    throw std::runtime_error(file + " is not compatible with " + reference + ": " + e.what());
+  }
+}
+
+void TreeMerge(const std::vector<std::string>& inputs,
+               const std::string& output,
+               int fan_in,
+               int n_workers,
+               const std::string& work_dir,
+               const std::vector<std::string>& skip) {
+  if( inputs.empty() )
+    throw std::runtime_error("Nothing to merge into " + output);
+  if( fan_in < 2 )
+    throw std::runtime_error("Merge fan-in must be at least 2");
+  // Absolute, since every job changes into its own level directory
+  const auto work_dir_path = AbsolutePath(work_dir);
+  mkdir(work_dir_path.c_str(), 0755);
+
+  std::vector<std::string> level_inputs;
+  for( const auto& input : inputs )
+    level_inputs.push_back(AbsolutePath(input));
+  const auto reference = level_inputs.front();
+  bool check = true;
+  int level = 0;
+  while( level_inputs.size() > 1 || check ){
+    auto dir = work_dir_path + "/level_" + std::to_string(level);
+    std::vector<std::string> level_outputs;
+    std::vector<WorkerJob> jobs;
+    for( size_t first=0; first<level_inputs.size(); first+=fan_in ){
+      auto last = std::min(level_inputs.size(), first + fan_in);
+      std::vector<std::string> group(level_inputs.begin() + first, level_inputs.begin() + last);
+      auto group_output = dir + "/" + std::to_string(level_outputs.size()) + ".root";
+      level_outputs.push_back(group_output);
+      jobs.push_back({dir, [group, group_output, reference, check, fan_in, &skip](){
+        if( check ){
+          for( const auto& input : group )
+            CheckCompatible(reference, input);
+        }
+        MergeFiles(group, group_output, fan_in, skip);
+      }});
+    }
+    std::cout << "Merge level " << level << ": " << level_inputs.size() << " files into "
+              << level_outputs.size() << std::endl;
+    RunInWorkers(n_workers, jobs);
+    if( level > 0 ){
+      for( const auto& file : level_inputs )
+        std::remove(file.c_str());
+    }
+    level_inputs = level_outputs;
+    check = false;
+    ++level;
+  }
+  if( std::rename(level_inputs.front().c_str(), output.c_str()) != 0 )
+    MergeFiles(level_inputs, output, fan_in);
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef HADES_FLOW_SRC_COMMON_MERGE_H_
+#define HADES_FLOW_SRC_COMMON_MERGE_H_
+
+#include <string>
+#include <vector>
+
+namespace HadesFlow {
+
+// Adds up `inputs` into `output` like hadd. Objects are added in the order of
+// `inputs` and trees are concatenated in that order, so the same inputs always
+// give a bit-identical output. At most `max_open` inputs are open at a time.
+// Objects named in `skip` are left out.
+void MergeFiles(const std::vector<std::string>& inputs, const std::string& output,
+                int max_open = 16, const std::vector<std::string>& skip = {});
+
+// Throws if `file` cannot be added to `reference`: a missing or extra object, an
+// object of another class, histograms or Qn containers with different axes or
+// trees with different branches.
+void CheckCompatible(const std::string& reference, const std::string& file);
+
+// Merges `inputs` into `output` as a tree: groups of `fan_in` files are merged by
+// up to `n_workers` parallel workers into intermediate files under `work_dir`,
+// which are merged again until one file is left. Every input is checked against
+// the first one before it is added. The grouping depends only on the inputs and
+// `fan_in`, not on the number of workers.
+void TreeMerge(const std::vector<std::string>& inputs,
+               const std::string& output,
+               int fan_in,
+               int n_workers,
+               const std::string& work_dir,
+               const std::vector<std::string>& skip = {});
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_MERGE_H_
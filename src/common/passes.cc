@@ -0,0 +1,347 @@
+#include "passes.h"
+
+#include <climits>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "file_list.h"
+#include "hash.h"
+#include "merge.h"
+#include "perf.h"
+#include "spill.h"
+#include "workers.h"
+
+namespace HadesFlow {
+
+namespace {
+
+// Input of the passes: either `file_list` itself, the event cache or a spill file
+// that has to be removed afterwards.
+struct PassInput {
+  std::string file_list;
+  std::string spill_file;
+};
+
+PassInput PrepareInput(const PassOptions& options,
+                       const std::string& file_list,
+                       const FieldList& fields,
+                       const std::string& spill_prefix) {
+  if( !options.cache_dir.empty() )
+    return {GetEventCache(file_list, fields, options.cache_dir), ""};
+  if( options.spill_dir.empty() )
+    return {file_list, ""};
+  PassInput input{spill_prefix + ".list", spill_prefix + ".root"};
+  SpillTree(file_list, "hades_analysis_tree", GetBranches(fields), input.spill_file);
+  WriteFileList(input.file_list, {input.spill_file});
+  return input;
+}
+
+std::string SpillPrefix(const PassOptions& options) {
+  return options.spill_dir + "/hades_flow_" + std::to_string(getpid());
+}
+
+void Cleanup(const PassInput& input) {
+  if( input.spill_file.empty() )
+    return;
+  std::remove(input.spill_file.c_str());
+  std::remove(input.file_list.c_str());
+}
+
+bool Exists(const std::string& path) {
+  return access(path.c_str(), R_OK) == 0;
+}
+
+const char* kCheckpoint = "checkpoint.txt";
+
+void NextPass(int i, int iterations) {
+  if( i+1 < iterations && std::rename("correction_out.root", "correction_in.root") != 0 )
+    throw std::runtime_error("Cannot move correction_out.root to correction_in.root");
+}
+
+// The checkpoint is written before and after the move, so a resumed run knows
+// whether correction_out.root is the complete output of the last pass.
+void FinishPass(int i, int iterations, uint64_t key) {
+  WriteCheckpoint(kCheckpoint, {i+1, false, key});
+  NextPass(i, iterations);
+  WriteCheckpoint(kCheckpoint, {i+1, true, key});
+}
+
+// Everything that changes the output of the passes
+uint64_t RunKey(const PassOptions& options, const std::string& file_list) {
+  auto key = Hash(0, std::to_string(options.iterations) + "\n" + options.calibration + "\n" +
+                     std::to_string(options.partial) + "\n" + options.config);
+  for( const auto& file : ReadFileList(file_list) )
+    key = Hash(key, file);
+  return key;
+}
+
+// Clears options.resume if the checkpoint belongs to another run
+Checkpoint Restore(PassOptions& options, uint64_t key) {
+  if( options.resume && Exists(kCheckpoint) && ReadCheckpoint(kCheckpoint).key != key ){
+    std::cout << kCheckpoint << " is from another file list or other options, starting over" << std::endl;
+    options.resume = false;
+  }
+  if( !options.resume ){
+    std::remove(kCheckpoint);
+    return {0, true, key};
+  }
+  auto checkpoint = ReadCheckpoint(kCheckpoint);
+  checkpoint.key = key;
+  if( !checkpoint.moved ){
+    // Killed between the move and the checkpoint after it
+    bool moved = !Exists("correction_out.root") && Exists("correction_in.root");
+    if( !moved )
+      NextPass(checkpoint.passes - 1, options.iterations);
+    WriteCheckpoint(kCheckpoint, {checkpoint.passes, true, key});
+  } else if( checkpoint.passes < options.iterations ){
+    // Left by the pass that was killed
+    std::remove("correction_out.root");
+  }
+  if( checkpoint.passes > 0 )
+    std::cout << "Resuming after pass " << checkpoint.passes << " of " << options.iterations << std::endl;
+  return checkpoint;
+}
+
+std::string PassMarker(int i) {
+  return "pass_" + std::to_string(i) + ".done";
+}
+
+// True if the input of a chunk was resolved by an earlier run and is still there,
+// spill files in $TMPDIR do not survive a requeue on another node.
+bool InputReady(const std::string& chunk_dir) {
+  if( !Exists(chunk_dir + "/input.list") )
+    return false;
+  for( const auto& file : ReadFileList(chunk_dir + "/input.list") ){
+    if( !Exists(file) )
+      return false;
+  }
+  return true;
+}
+
+const char* kQvectorTree = "tree";
+
+std::string CurrentDir() {
+  char buffer[PATH_MAX];
+  if( !getcwd(buffer, sizeof(buffer)) )
+    throw std::runtime_error("Cannot get the working directory");
+  return buffer;
+}
+
+std::string AbsolutePath(const std::string& path, const std::string& cwd) {
+  if( path.empty() || path.front() == '/' )
+    return path;
+  return cwd + "/" + path;
+}
+
+// The spill files a chunk input was resolved to by an earlier run, to be removed
+// with those of this run. Lists of the input files or of the cache are kept.
+PassInput SpilledInput(const PassOptions& options, const std::string& chunk_dir) {
+  const std::string suffix = ".root";
+  const auto spill_files = options.spill_dir + "/hades_flow_";
+  auto files = ReadFileList(chunk_dir + "/input.list");
+  if( files.size() != 1 )
+    return {};
+  const auto& file = files.front();
+  if( file.compare(0, spill_files.size(), spill_files) != 0 || file.size() < spill_files.size() + suffix.size() ||
+      file.compare(file.size() - suffix.size(), suffix.size(), suffix) != 0 )
+    return {};
+  return {file.substr(0, file.size() - suffix.size()) + ".list", file};
+}
+
+void UseCalibration(const std::string& calibration) {
+  auto path = AbsolutePath(calibration, CurrentDir());
+  if( access(path.c_str(), R_OK) != 0 )
+    throw std::runtime_error("Cannot read calibration " + path);
+  unlink("correction_in.root");
+  if( symlink(path.c_str(), "correction_in.root") != 0 )
+    throw std::runtime_error("Cannot link " + path + " to correction_in.root");
+}
+
+void KeepPartial() {
+  // Already kept by the run that is resumed
+  if( !Exists("correction_out.root") && Exists("correction_partial.root") )
+    return;
+  MergeFiles({"correction_out.root"}, "correction_partial.root", 1, {kQvectorTree});
+  std::remove("correction_out.root");
+}
+
+void RunChunked(const PassOptions& options,
+                const Checkpoint& checkpoint,
+                const std::string& file_list,
+                const FieldList& fields,
+                const PassFunction& pass) {
+  if( options.chunk_files < 1 )
+    throw std::runtime_error("Number of files per chunk must be positive");
+  if( options.work_dir.empty() )
+    throw std::runtime_error("Work directory for the chunks is not set");
+  const auto cwd = CurrentDir();
+  const auto work_dir = AbsolutePath(options.work_dir, cwd);
+  mkdir(work_dir.c_str(), 0755);
+
+  auto files = ReadFileList(file_list);
+  std::vector<std::string> chunk_dirs;
+  for( size_t first=0; first<files.size(); first+=options.chunk_files ){
+    auto dir = work_dir + "/" + std::to_string(chunk_dirs.size());
+    mkdir(dir.c_str(), 0755);
+    auto last = std::min(files.size(), first + options.chunk_files);
+    std::vector<std::string> chunk{files.begin() + first, files.begin() + last};
+    // Progress of a chunk is only valid for the same files
+    if( !options.resume || !Exists(dir + "/list.txt") || ReadFileList(dir + "/list.txt") != chunk ){
+      std::remove((dir + "/input.list").c_str());
+      for( int i=0; i<options.iterations; ++i )
+        std::remove((dir + "/" + PassMarker(i)).c_str());
+    }
+    WriteFileList(dir + "/list.txt", chunk);
+    chunk_dirs.push_back(dir);
+  }
+  std::cout << "Split " << files.size() << " files into " << chunk_dirs.size()
+            << " chunks processed by " << options.threads << " workers" << std::endl;
+
+  // Workers resolve their chunk input (list, cache or spill) into input.list.
+  std::vector<PassInput> inputs;
+  std::vector<WorkerJob> prepare;
+  for( size_t i=0; i<chunk_dirs.size(); ++i ){
+    auto spill_prefix = SpillPrefix(options) + "_" + std::to_string(i);
+    inputs.push_back({});
+    if( InputReady(chunk_dirs[i]) ){
+      if( !options.spill_dir.empty() )
+        inputs.back() = SpilledInput(options, chunk_dirs[i]);
+      continue;
+    }
+    if( checkpoint.passes == options.iterations )
+      continue;
+    if( !options.spill_dir.empty() )
+      inputs.back() = {spill_prefix + ".list", spill_prefix + ".root"};
+    prepare.push_back({chunk_dirs[i], [&options, &fields, spill_prefix](){
+      auto input = PrepareInput(options, "list.txt", fields, spill_prefix);
+      WriteFileList("input.list", ReadFileList(input.file_list));
+    }});
+  }
+  {
+    ScopedStage stage("prepare input");
+    RunInWorkers(options.threads, prepare);
+  }
+
+  const auto correction_in = cwd + "/correction_in.root";
+  for( int i=checkpoint.passes; i<options.iterations; ++i ){
+    std::cout << "Correction pass " << i+1 << " of " << options.iterations << std::endl;
+    std::vector<WorkerJob> jobs;
+    std::vector<std::string> outputs;
+    for( size_t c=0; c<chunk_dirs.size(); ++c ){
+      outputs.push_back(chunk_dirs[c] + "/correction_out.root");
+      if( Exists(chunk_dirs[c] + "/" + PassMarker(i)) )
+        continue;
+      auto link = chunk_dirs[c] + "/correction_in.root";
+      unlink(link.c_str());
+      if( Exists(correction_in) && symlink(correction_in.c_str(), link.c_str()) != 0 )
+        throw std::runtime_error("Cannot link " + correction_in + " into " + chunk_dirs[c]);
+      jobs.push_back({chunk_dirs[c], [&pass, i](){
+        Perf::Get().Reset();
+        {
+          ScopedStage stage("pass");
+          pass("input.list", i);
+        }
+        if( Perf::Get().IsEnabled() )
+          Perf::Get().Save("perf.txt");
+        WriteFileList(PassMarker(i), {});
+      }});
+    }
+    if( jobs.size() < chunk_dirs.size() )
+      std::cout << chunk_dirs.size() - jobs.size() << " chunks are done already" << std::endl;
+    RunInWorkers(options.threads, jobs);
+    if( Perf::Get().IsEnabled() ){
+      for( const auto& job : jobs )
+        Perf::Get().Load(job.work_dir + "/perf.txt");
+    }
+    {
+      // The next pass only reads the correction histograms
+      ScopedStage stage("merge");
+      if( i+1 < options.iterations )
+        MergeFiles(outputs, cwd + "/correction_out.root", 16, {kQvectorTree});
+      else
+        MergeFiles(outputs, cwd + "/correction_out.root");
+    }
+    FinishPass(i, options.iterations, checkpoint.key);
+  }
+
+  for( const auto& input : inputs )
+    Cleanup(input);
+}
+
+}
+
+void AddPassOptions(boost::program_options::options_description& options, PassOptions& pass_options) {
+  namespace po = boost::program_options;
+  options.add_options()
+      ("iterations,n", po::value<int>(&pass_options.iterations)->default_value(1),
+       "Number of correction passes performed in one process")
+      ("spill-dir", po::value<std::string>(&pass_options.spill_dir),
+       "Directory for a local copy of the used branches, read by all passes (e.g. /dev/shm or $TMPDIR)")
+      ("cache-dir", po::value<std::string>(&pass_options.cache_dir),
+       "Directory of the persistent event cache, reused by later runs on the same input")
+      ("threads,t", po::value<int>(&pass_options.threads)->default_value(0),
+       "Number of parallel workers over chunks of the file list, 0 to run in this process")
+      ("chunk-files", po::value<int>(&pass_options.chunk_files)->default_value(1),
+       "Number of input files per chunk in the parallel mode")
+      ("work-dir", po::value<std::string>(&pass_options.work_dir)->default_value("chunks"),
+       "Directory for the per-chunk outputs in the parallel mode")
+      ("calibration", po::value<std::string>(&pass_options.calibration),
+       "Correction file used instead of correction_in.root, e.g. the merged calibration of all jobs")
+      ("partial", po::bool_switch(&pass_options.partial),
+       "Run one pass and write only its correction statistics to correction_partial.root")
+      ("resume", po::bool_switch(&pass_options.resume),
+       "Continue a killed run from checkpoint.txt; use --threads 1 for checkpoints after every chunk")
+      ("perf-json", po::value<std::string>(&pass_options.perf_json),
+       "Write the time per stage, events/s, bytes read and peak RSS to this JSON file");
+}
+
+void RunPasses(PassOptions options,
+               const std::string& file_list,
+               const FieldList& fields,
+               const PassFunction& pass) {
+  if( options.iterations < 1 )
+    throw std::runtime_error("Number of iterations must be positive");
+  if( options.partial && options.iterations != 1 )
+    throw std::runtime_error("The partial mode runs exactly one pass per round");
+  if( !options.perf_json.empty() )
+    Perf::Get().Enable();
+  // The chunks are processed in their own directories
+  const auto cwd = CurrentDir();
+  options.spill_dir = AbsolutePath(options.spill_dir, cwd);
+  options.cache_dir = AbsolutePath(options.cache_dir, cwd);
+  auto checkpoint = Restore(options, RunKey(options, file_list));
+  if( checkpoint.passes == 0 && !options.calibration.empty() )
+    UseCalibration(options.calibration);
+  {
+    ScopedStage total("total");
+    if( options.threads > 0 ){
+      RunChunked(options, checkpoint, file_list, fields, pass);
+    } else if( checkpoint.passes < options.iterations ){
+      PassInput input;
+      {
+        ScopedStage stage("prepare input");
+        input = PrepareInput(options, file_list, fields, SpillPrefix(options));
+      }
+      for( int i=checkpoint.passes; i<options.iterations; ++i ){
+        std::cout << "Correction pass " << i+1 << " of " << options.iterations << std::endl;
+        {
+          ScopedStage stage("pass");
+          pass(input.file_list, i);
+        }
+        FinishPass(i, options.iterations, checkpoint.key);
+      }
+      Cleanup(input);
+    }
+    if( options.partial )
+      KeepPartial();
+  }
+  if( !options.perf_json.empty() )
+    Perf::Get().WriteJson(options.perf_json);
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef HADES_FLOW_SRC_COMMON_PASSES_H_
+#define HADES_FLOW_SRC_COMMON_PASSES_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "event_cache.h"
+
+namespace HadesFlow {
+
+struct PassOptions {
+  int iterations{1};
+  std::string spill_dir;
+  std::string cache_dir;
+  int threads{0};
+  int chunk_files{1};
+  std::string work_dir{"chunks"};
+  std::string calibration;
+  bool partial{false};
+  bool resume{false};
+  std::string perf_json;
+  // Options of the program that change the Q-vectors, part of the checkpoint key
+  std::string config;
+};
+
+// Runs one correction pass over a file list; `pass` counts from 0.
+using PassFunction = std::function<void(const std::string& file_list, int pass)>;
+
+void AddPassOptions(boost::program_options::options_description& options, PassOptions& pass_options);
+
+// Runs `pass` options.iterations times. Between the passes correction_out.root is
+// moved to correction_in.root, exactly as the batch scripts did between separate
+// runs; the output of the last pass stays in correction_out.root.
+// With a cache directory the passes read the persistent event cache of `fields`
+// (see GetEventCache()); with a spill directory the branches of `fields` are decoded
+// once into a local copy that is removed after the last pass.
+//
+// With options.threads > 0 the file list is split into chunks of chunk_files files,
+// each pass runs on the chunks in that many parallel workers and the chunk outputs
+// are merged in chunk order. The chunking does not depend on the number of
+// workers, so the merged output is bit-identical for any thread count.
+//
+// For calibration across array jobs a calibration file replaces correction_in.root
+// of the first pass, and the partial mode runs a single pass and keeps only its
+// correction statistics, without the Q-vector tree, in correction_partial.root.
+// Merging the partial files of all jobs gives the global calibration for the next
+// round; the last round runs without --partial and applies it.
+//
+// Progress is recorded in checkpoint.txt after every pass and, in the parallel
+// mode, by a marker per finished chunk. With options.resume a killed run continues
+// after the last complete pass and skips the chunks already done in the current one.
+// The checkpoint stores a hash of the file list, the number of iterations, the
+// calibration, the partial mode and options.config; a checkpoint with another hash
+// is not resumed, the run starts over.
+//
+// With options.perf_json the timing of all stages, including those of the workers,
+// is written to that file as JSON (see Perf).
+void RunPasses(PassOptions options,
+               const std::string& file_list,
+               const FieldList& fields,
+               const PassFunction& pass);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_PASSES_H_
@@ -0,0 +1,196 @@
+#include "perf.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <TChain.h>
+#include <TFile.h>
+
+namespace HadesFlow {
+
+namespace {
+
+std::string Quote(const std::string& text) {
+  std::string quoted = "\"";
+  for( auto c : text ){
+    if( c == '"' || c == '\\' )
+      quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+// Names are written as one token per line in the text state
+std::string Escape(std::string name) {
+  std::replace(name.begin(), name.end(), ' ', '\x1f');
+  return name;
+}
+
+std::string Unescape(std::string name) {
+  std::replace(name.begin(), name.end(), '\x1f', ' ');
+  return name;
+}
+
+long PeakRssKb() {
+  rusage self{}, children{};
+  getrusage(RUSAGE_SELF, &self);
+  getrusage(RUSAGE_CHILDREN, &children);
+  return std::max(self.ru_maxrss, children.ru_maxrss);
+}
+
+}
+
+Perf& Perf::Get() {
+  static Perf perf;
+  return perf;
+}
+
+void Perf::Enable() {
+  enabled_ = true;
+  bytes_read_start_ = TFile::GetFileBytesRead();
+}
+
+void Perf::AddStage(const std::string& name, const StageTime& time) {
+  auto& stage = stages_[name];
+  stage.wall += time.wall;
+  stage.cpu += time.cpu;
+  stage.calls += time.calls;
+}
+
+void Perf::AddCounter(const std::string& name, double value) {
+  counters_[name] += value;
+}
+
+std::shared_ptr<SampledStage> Perf::Sample(const std::string& name) {
+  if( !enabled_ )
+    return nullptr;
+  sampled_.push_back(std::make_shared<SampledStage>());
+  sampled_.back()->name = name;
+  return sampled_.back();
+}
+
+void Perf::Reset() {
+  stages_.clear();
+  counters_.clear();
+  sampled_.clear();
+  bytes_read_start_ = TFile::GetFileBytesRead();
+}
+
+std::map<std::string, StageTime> Perf::Stages() const {
+  auto stages = stages_;
+  for( const auto& sampled : sampled_ ){
+    const auto calls = sampled->calls.load();
+    const auto timed = sampled->timed.load();
+    if( timed == 0 )
+      continue;
+    auto& stage = stages[sampled->name];
+    stage.wall += 1e-9 * sampled->wall_ns.load() * calls / timed;
+    stage.calls += calls;
+  }
+  return stages;
+}
+
+std::map<std::string, double> Perf::Counters() const {
+  auto counters = counters_;
+  counters["bytes_read"] += TFile::GetFileBytesRead() - bytes_read_start_;
+  return counters;
+}
+
+void Perf::Save(const std::string& path) const {
+  std::ofstream out(path);
+  if( !out )
+    throw std::runtime_error("Cannot write " + path);
+  out << std::setprecision(17);
+  for( const auto& [name, stage] : Stages() )
+    out << "stage " << Escape(name) << " " << stage.wall << " " << stage.cpu << " " << stage.calls << "\n";
+  for( const auto& [name, value] : Counters() )
+    out << "counter " << Escape(name) << " " << value << "\n";
+}
+
+void Perf::Load(const std::string& path) {
+  std::ifstream in(path);
+  if( !in )
+    throw std::runtime_error("Cannot read " + path);
+  std::string type, name;
+  while( in >> type >> name ){
+    if( type == "stage" ){
+      StageTime stage;
+      in >> stage.wall >> stage.cpu >> stage.calls;
+      AddStage(Unescape(name), stage);
+    } else if( type == "counter" ){
+      double value;
+      in >> value;
+      AddCounter(Unescape(name), value);
+    } else {
+      throw std::runtime_error("Unknown entry " + type + " in " + path);
+    }
+  }
+}
+
+void Perf::WriteJson(const std::string& path) const {
+  std::ofstream out(path);
+  if( !out )
+    throw std::runtime_error("Cannot write " + path);
+  const auto stages = Stages();
+  const auto counters = Counters();
+  char host[256]{};
+  gethostname(host, sizeof(host) - 1);
+  const char* task = std::getenv("SLURM_ARRAY_TASK_ID");
+
+  out << std::setprecision(6) << "{\n";
+  out << "  \"host\": " << Quote(host) << ",\n";
+  out << "  \"task\": " << (task ? Quote(task) : "null") << ",\n";
+  out << "  \"stages\": {";
+  bool first = true;
+  for( const auto& [name, stage] : stages ){
+    out << (first ? "\n" : ",\n") << "    " << Quote(name) << ": {\"wall_s\": " << stage.wall
+        << ", \"cpu_s\": " << stage.cpu << ", \"calls\": " << stage.calls << "}";
+    first = false;
+  }
+  out << "\n  },\n";
+  for( const auto& [name, value] : counters )
+    out << "  " << Quote(name) << ": " << std::setprecision(15) << value << ",\n";
+  // Throughput of the whole job if it has a total stage, otherwise of the event loop
+  auto total = stages.count("total") ? stages.find("total") : stages.find("event loop");
+  auto events = counters.find("events");
+  if( total != stages.end() && events != counters.end() && total->second.wall > 0 )
+    out << "  \"events_per_s\": " << std::setprecision(6) << events->second / total->second.wall << ",\n";
+  out << "  \"peak_rss_kb\": " << PeakRssKb() << "\n";
+  out << "}\n";
+}
+
+ScopedStage::ScopedStage(std::string name) :
+    name_(std::move(name)),
+    enabled_(Perf::Get().IsEnabled()),
+    wall_start_(std::chrono::steady_clock::now()),
+    cpu_start_(std::clock()) {}
+
+ScopedStage::~ScopedStage() {
+  if( !enabled_ )
+    return;
+  StageTime time;
+  time.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start_).count();
+  time.cpu = static_cast<double>(std::clock() - cpu_start_) / CLOCKS_PER_SEC;
+  time.calls = 1;
+  Perf::Get().AddStage(name_, time);
+}
+
+void CountEvents(const std::vector<std::string>& files, const std::string& tree, long long limit) {
+  if( !Perf::Get().IsEnabled() )
+    return;
+  TChain chain(tree.c_str());
+  for( const auto& file : files )
+    chain.Add(file.c_str());
+  auto entries = chain.GetEntries();
+  if( limit > 0 )
+    entries = std::min<long long>(entries, limit);
+  Perf::Get().AddCounter("events", entries);
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef HADES_FLOW_SRC_COMMON_PERF_H_
+#define HADES_FLOW_SRC_COMMON_PERF_H_
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace HadesFlow {
+
+struct StageTime {
+  double wall{0.0};
+  double cpu{0.0};
+  long long calls{0};
+};
+
+// Function called in the event loop, timed on every kSamplingPeriod-th call.
+// The counters may be updated from several threads.
+struct SampledStage {
+  std::string name;
+  std::atomic<long long> calls{0};
+  std::atomic<long long> timed{0};
+  std::atomic<long long> wall_ns{0};
+};
+
+constexpr long long kSamplingPeriod = 64;
+
+// Timing of a job: wall and CPU time per stage, the sampled time of the variables
+// and cuts evaluated per track, events, bytes read and peak RSS. Disabled unless
+// Enable() is called, then the timers below cost one branch.
+class Perf {
+ public:
+  static Perf& Get();
+
+  void Enable();
+  bool IsEnabled() const { return enabled_; }
+
+  void AddStage(const std::string& name, const StageTime& time);
+  void AddCounter(const std::string& name, double value);
+  // Returns null if disabled
+  std::shared_ptr<SampledStage> Sample(const std::string& name);
+
+  // Forgets everything measured so far, called in forked workers.
+  void Reset();
+  // Plain text state, used to collect the timing of the forked workers.
+  void Save(const std::string& path) const;
+  void Load(const std::string& path);
+
+  void WriteJson(const std::string& path) const;
+
+ private:
+  std::map<std::string, StageTime> Stages() const;
+  std::map<std::string, double> Counters() const;
+
+  bool enabled_{false};
+  double bytes_read_start_{0.0};
+  std::map<std::string, StageTime> stages_;
+  std::map<std::string, double> counters_;
+  std::vector<std::shared_ptr<SampledStage>> sampled_;
+};
+
+// Adds the wall and CPU time of its scope to a stage.
+class ScopedStage {
+ public:
+  explicit ScopedStage(std::string name);
+  ~ScopedStage();
+  ScopedStage(const ScopedStage&) = delete;
+  ScopedStage& operator=(const ScopedStage&) = delete;
+
+ private:
+  std::string name_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point wall_start_;
+  std::clock_t cpu_start_;
+};
+
+// Wraps a function called per track. A clock read on every call would cost more
+// than most of these functions, so only every kSamplingPeriod-th call is timed and
+// the report scales the sampled time by the number of calls. If the timing is
+// disabled `function` is returned as it is.
+template<typename Signature, typename Function>
+std::function<Signature> Sampled(const std::string& name, Function function) {
+  auto stage = Perf::Get().Sample(name);
+  if( !stage )
+    return function;
+  return [function, stage](auto&&... args) mutable {
+    if( (stage->calls.fetch_add(1, std::memory_order_relaxed) + 1) % kSamplingPeriod != 0 )
+      return function(std::forward<decltype(args)>(args)...);
+    auto start = std::chrono::steady_clock::now();
+    auto result = function(std::forward<decltype(args)>(args)...);
+    auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    stage->wall_ns.fetch_add(wall.count(), std::memory_order_relaxed);
+    stage->timed.fetch_add(1, std::memory_order_relaxed);
+    return result;
+  };
+}
+
+// Adds the number of entries of `tree` in `files`, at most `limit` if positive, to
+// the "events" counter. Does nothing if the timing is disabled.
+void CountEvents(const std::vector<std::string>& files, const std::string& tree, long long limit = -1);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_PERF_H_
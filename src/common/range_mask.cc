@@ -0,0 +1,65 @@
+#include "range_mask.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HADES_FLOW_AVX2 1
+#endif
+
+namespace HadesFlow {
+
+namespace {
+
+void SetRangeBitsScalar(const double* values, size_t n, const Range& range, int bit, uint32_t* masks) {
+  for( size_t i=0; i<n; ++i )
+    masks[i] |= static_cast<uint32_t>(range(values[i])) << bit;
+}
+
+#ifdef HADES_FLOW_AVX2
+template<int kLoCompare, int kHiCompare>
+__attribute__((target("avx2")))
+void SetRangeBitsAvx2(const double* values, size_t n, const Range& range, int bit, uint32_t* masks) {
+  const auto lo = _mm256_set1_pd(range.lo);
+  const auto hi = _mm256_set1_pd(range.hi);
+  const auto flag = _mm_set1_epi32(static_cast<int>(1u << bit));
+  // Low 32 bits of each 64-bit comparison result
+  const auto narrow = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+  size_t i = 0;
+  for( ; i+4<=n; i+=4 ){
+    const auto value = _mm256_loadu_pd(values + i);
+    const auto inside = _mm256_and_pd(_mm256_cmp_pd(lo, value, kLoCompare),
+                                      _mm256_cmp_pd(value, hi, kHiCompare));
+    const auto inside32 = _mm256_castsi256_si128(
+        _mm256_permutevar8x32_epi32(_mm256_castpd_si256(inside), narrow));
+    auto* mask = reinterpret_cast<__m128i*>(masks + i);
+    _mm_storeu_si128(mask, _mm_or_si128(_mm_loadu_si128(mask), _mm_and_si128(inside32, flag)));
+  }
+  SetRangeBitsScalar(values + i, n - i, range, bit, masks + i);
+}
+
+bool HasAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+#endif
+
+}
+
+void SetRangeBits(const double* values, size_t n, const Range& range, int bit, uint32_t* masks) {
+#ifdef HADES_FLOW_AVX2
+  if( HasAvx2() ){
+    // Ordered comparisons are false for NaN, like the scalar ones
+    if( range.lo_closed && range.hi_closed )
+      SetRangeBitsAvx2<_CMP_LE_OQ, _CMP_LE_OQ>(values, n, range, bit, masks);
+    else if( range.lo_closed )
+      SetRangeBitsAvx2<_CMP_LE_OQ, _CMP_LT_OQ>(values, n, range, bit, masks);
+    else if( range.hi_closed )
+      SetRangeBitsAvx2<_CMP_LT_OQ, _CMP_LE_OQ>(values, n, range, bit, masks);
+    else
+      SetRangeBitsAvx2<_CMP_LT_OQ, _CMP_LT_OQ>(values, n, range, bit, masks);
+    return;
+  }
+#endif
+  SetRangeBitsScalar(values, n, range, bit, masks);
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef HADES_FLOW_SRC_COMMON_RANGE_MASK_H_
+#define HADES_FLOW_SRC_COMMON_RANGE_MASK_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cut_plan.h"
+
+namespace HadesFlow {
+
+// Sets `bit` in masks[i] for every values[i] inside `range`, leaving the other bits.
+// Runs four values per instruction with AVX2 if the CPU supports it, otherwise a
+// scalar loop; both give the same masks as Range::operator(), NaN included.
+void SetRangeBits(const double* values, size_t n, const Range& range, int bit, uint32_t* masks);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_RANGE_MASK_H_
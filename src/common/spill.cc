@@ -0,0 +1,101 @@
+#include "spill.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#include <Compression.h>
+#include <TChain.h>
+#include <TClass.h>
+#include <TDataType.h>
+#include <TFile.h>
+#include <TKey.h>
+#include <TTree.h>
+
+#include "file_list.h"
+
+namespace HadesFlow {
+
+namespace {
+
+std::vector<std::string> WithMatches(TTree& tree, const std::vector<std::string>& branches) {
+  auto result = branches;
+  for( const auto& from : branches ){
+    for( const auto& to : branches ){
+      auto match = from + "2" + to;
+      if( from != to && tree.GetBranch(match.c_str()) )
+        result.push_back(match);
+    }
+  }
+  return result;
+}
+
+}
+
+void SpillTree(const std::string& file_list,
+               const std::string& tree_name,
+               const std::vector<std::string>& branches,
+               const std::string& spill_file) {
+  auto files = ReadFileList(file_list);
+  if( files.empty() )
+    throw std::runtime_error("File list " + file_list + " is empty");
+
+  TChain chain(tree_name.c_str());
+  for( const auto& file : files )
+    chain.Add(file.c_str());
+  if( chain.LoadTree(0) < 0 )
+    throw std::runtime_error("Cannot read " + tree_name + " from " + files.front());
+  auto kept = WithMatches(chain, branches);
+  chain.SetBranchStatus("*", false);
+
+  std::unique_ptr<TFile> out{TFile::Open(spill_file.c_str(), "recreate", "",
+                                         ROOT::CompressionSettings(ROOT::kLZ4, 1))};
+  if( !out || out->IsZombie() )
+    throw std::runtime_error("Cannot create spill file " + spill_file);
+
+  std::unique_ptr<TFile> first{TFile::Open(files.front().c_str(), "read")};
+  if( !first || first->IsZombie() )
+    throw std::runtime_error("Cannot open " + files.front());
+  TIter next(first->GetListOfKeys());
+  while( auto* key = dynamic_cast<TKey*>(next()) ){
+    if( std::string(key->GetClassName()) == "TTree" )
+      continue;
+    auto* obj = key->ReadObj();
+    out->cd();
+    obj->Write(key->GetName());
+  }
+  first->Close();
+
+  out->cd();
+  auto* tree = new TTree(tree_name.c_str(), tree_name.c_str());
+  std::vector<std::pair<TClass*, void*>> objects;
+  objects.reserve(kept.size());
+  for( const auto& name : kept ){
+    auto* branch = chain.GetBranch(name.c_str());
+    if( !branch )
+      throw std::runtime_error("No branch " + name + " in " + tree_name);
+    auto* cl = TClass::GetClass(branch->GetClassName());
+    if( !cl )
+      throw std::runtime_error("No dictionary for branch " + name);
+    objects.emplace_back(cl, cl->New());
+    chain.SetBranchStatus((name + "*").c_str(), true);
+    chain.SetBranchAddress(name.c_str(), &objects.back().second, nullptr, cl, kOther_t, true);
+    tree->Branch(name.c_str(), cl->GetName(), &objects.back().second, 32000, 99);
+  }
+
+  const auto n_events = chain.GetEntries();
+  for( Long64_t i=0; i<n_events; ++i ){
+    chain.GetEntry(i);
+    tree->Fill();
+  }
+  std::cout << "Spilled " << n_events << " events of " << tree_name
+            << " into " << spill_file << std::endl;
+  tree->Write();
+  out->Close();
+  chain.ResetBranchAddresses();
+  for( auto& object : objects )
+    object.first->Destructor(object.second);
+}
+
+}
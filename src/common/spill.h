@@ -0,0 +1,22 @@
+#ifndef HADES_FLOW_SRC_COMMON_SPILL_H_
+#define HADES_FLOW_SRC_COMMON_SPILL_H_
+
+#include <string>
+#include <vector>
+
+namespace HadesFlow {
+
+// Decodes the given branches of `tree_name` once from every file in `file_list` and
+// writes them, LZ4-compressed and fully split, into `spill_file` together with the
+// non-tree objects (DataHeader, Configuration) of the first file. Full splitting
+// stores every data member of the AnalysisTree containers as its own column, so a
+// later read only touches contiguous baskets of the members it needs. Matching
+// branches between two kept branches ("mdc_vtx_tracks2meta_hits") are kept as well.
+void SpillTree(const std::string& file_list,
+               const std::string& tree_name,
+               const std::vector<std::string>& branches,
+               const std::string& spill_file);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_SPILL_H_
@@ -0,0 +1,70 @@
+#ifndef HADES_FLOW_SRC_COMMON_VARIABLES_H_
+#define HADES_FLOW_SRC_COMMON_VARIABLES_H_
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <AnalysisTree/Variable.hpp>
+
+#include "perf.h"
+
+namespace HadesFlow {
+
+// Derived variable of exactly N fields. `function` receives the field values as
+// std::array<double, N>, copied on the stack from the framework's argument: the
+// arity is checked once here instead of by .at() on every call, and the function
+// can keep per-event state (see LastValue) since it may be mutable. Its time is
+// sampled as the stage "variable <name>" when the timing is enabled.
+template<size_t N, typename Function>
+AnalysisTree::Variable MakeVariable(const std::string& name,
+                                    const std::vector<AnalysisTree::Field>& fields,
+                                    Function function) {
+  if( fields.size() != N )
+    throw std::runtime_error("Variable " + name + " expects " + std::to_string(N) + " fields");
+  auto lambda = [function](const std::vector<double>& var) mutable {
+    std::array<double, N> values;
+    std::copy_n(var.data(), N, values.begin());
+    return function(values);
+  };
+  return AnalysisTree::Variable(name, fields,
+                                Sampled<double(const std::vector<double>&)>("variable " + name, lambda));
+}
+
+// The field `field` of `branch` under the name `name`, e.g. a field filled by
+// DerivedFieldsTask under the name of the variable it replaces, so that the axes
+// and QA histograms keep their names.
+inline AnalysisTree::Variable NamedField(const std::string& name, const std::string& branch,
+                                         const std::string& field) {
+  return MakeVariable<1>(name, {{branch, field}}, [](const std::array<double, 1>& var){ return var[0]; });
+}
+
+// Remembers the result for the last input. Per-track variables that depend on an
+// event quantity (e.g. the centrality class of the efficiency) compute it once per
+// event instead of once per track.
+template<typename Function>
+class LastValue {
+ public:
+  explicit LastValue(Function function) : function_(std::move(function)) {}
+  auto operator()(double input) -> decltype(std::declval<Function&>()(input)) {
+    if( !valid_ || input != input_ ){
+      input_ = input;
+      result_ = function_(input);
+      valid_ = true;
+    }
+    return result_;
+  }
+
+ private:
+  Function function_;
+  bool valid_{false};
+  double input_{0.0};
+  decltype(std::declval<Function&>()(0.0)) result_{};
+};
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_VARIABLES_H_
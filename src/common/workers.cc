@@ -0,0 +1,83 @@
+#include "workers.h"
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace HadesFlow {
+
+namespace {
+
+[[noreturn]] void RunChild(const WorkerJob& job) {
+  int status = EXIT_FAILURE;
+  try {
+    mkdir(job.work_dir.c_str(), 0755);
+    if( chdir(job.work_dir.c_str()) != 0 )
+      throw std::runtime_error("Cannot enter " + job.work_dir);
+    std::cout.flush();
+    std::fflush(nullptr);
+    int log = open("log.txt", O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if( log >= 0 ){
+      dup2(log, STDOUT_FILENO);
+      dup2(log, STDERR_FILENO);
+      close(log);
+    }
+    job.run();
+    status = EXIT_SUCCESS;
+  } catch (const std::exception& e) {
+    std::cerr << "Worker in " << job.work_dir << " failed: " << e.what() << std::endl;
+  }
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(nullptr);
+  _exit(status);
+}
+
+}
+
+void RunInWorkers(int n_workers, const std::vector<WorkerJob>& jobs) {
+  if( n_workers < 1 )
+    throw std::runtime_error("Number of workers must be positive");
+  std::map<pid_t, size_t> running;
+  std::vector<size_t> failed;
+  size_t next = 0;
+  std::cout.flush();
+  std::fflush(nullptr);
+  while( next < jobs.size() || !running.empty() ){
+    if( next < jobs.size() && running.size() < static_cast<size_t>(n_workers) ){
+      auto pid = fork();
+      if( pid < 0 )
+        throw std::runtime_error("Cannot fork a worker");
+      if( pid == 0 )
+        RunChild(jobs[next]);
+      running.emplace(pid, next);
+      ++next;
+      continue;
+    }
+    int status = 0;
+    auto pid = waitpid(-1, &status, 0);
+    if( pid < 0 )
+      throw std::runtime_error("Lost track of the workers");
+    auto job = running.find(pid);
+    if( job == running.end() )
+      continue;
+    if( !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS )
+      failed.push_back(job->second);
+    running.erase(job);
+  }
+  if( !failed.empty() ){
+    std::string dirs;
+    for( auto i : failed )
+      dirs += " " + jobs[i].work_dir;
+    throw std::runtime_error("Workers failed, see log.txt in:" + dirs);
+  }
+}
+
+}
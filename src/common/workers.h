@@ -0,0 +1,24 @@
+#ifndef HADES_FLOW_SRC_COMMON_WORKERS_H_
+#define HADES_FLOW_SRC_COMMON_WORKERS_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace HadesFlow {
+
+struct WorkerJob {
+  std::string work_dir;
+  std::function<void()> run;
+};
+
+// Runs every job in its own forked process inside its work directory, at most
+// `n_workers` at a time, with stdout and stderr redirected to work_dir/log.txt.
+// The Qn framework and ROOT keep global state (gDirectory, fixed output file
+// names), so jobs are isolated in processes rather than threads.
+// Throws if any of the jobs failed.
+void RunInWorkers(int n_workers, const std::vector<WorkerJob>& jobs);
+
+}
+
+#endif // HADES_FLOW_SRC_COMMON_WORKERS_H_
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <memory>
+#include <boost/program_options.hpp>
 
 #include <GlobalConfig.h>
 
@@ -11,27 +13,36 @@
 #include <cuts.h>
 #include <corrections.h>
 
-int main(int argc, char **argv) {
-  using namespace std;
-  if(argc < 2){
-    std::cout << "Error! Please use " << std::endl;
-    std::cout << " ./correct filelist.txt path/to/efficiency.root" << std::endl;
-    exit(EXIT_FAILURE);
-  }
-  const string file_list = argv[1];
-  const string eff_file = argv[2];
+#include <common/cut_plan.h>
+#include <common/derived_fields.h>
+#include <common/file_list.h>
+#include <common/matching.h>
+#include <common/efficiency_table.h>
+#include <common/passes.h>
+#include <common/perf.h>
+#include <common/variables.h>
+
+struct EfficiencyOptions {
+  std::string file;
+  int centrality_class{-1};
+  bool interpolate{false};
+  bool reco_qvectors{false};
+};
 
+// `efficiency_table` is only read by the reco Q-vectors and may be null without them
+void Correct(const std::string& file_list, const EfficiencyOptions& eff_options,
+             const HadesFlow::EfficiencyTable* efficiency_table){
+  using namespace std;
   const string event_header = "event_header";
   const string vtx_tracks = "mdc_vtx_tracks";
   const string sim_tracks = "sim_tracks";
   const string sim_event = "sim_header";
 
-  AnalysisTree::Variable centrality("Centrality",
-                                    {{event_header, "selected_tof_rpc_hits"}},
-                                    [](const std::vector<double> &var){
-                                      return HadesUtils::Centrality::GetValue(var.at(0),
-                                                                              HadesUtils::DATA_TYPE::AuAu_1_23AGeV);});
-  HadesUtils::Corrections::ReadMaps(eff_file);
+  auto centrality = HadesFlow::MakeVariable<1>("Centrality",
+                                               {{event_header, "selected_tof_rpc_hits"}},
+                                               [](const std::array<double, 1> &var){
+                                                 return HadesUtils::Centrality::GetValue(var[0],
+                                                                                         HadesUtils::DATA_TYPE::AuAu_1_23AGeV);});
   double beam_rapidity;
   try {
     beam_rapidity =
@@ -43,81 +54,81 @@ int main(int argc, char **argv) {
             file_list, "data_information")->GetBeamRapidity();
   }
 
-  AnalysisTree::Variable y_cm("y_cm",
-                              {{vtx_tracks, "rapidity"}},
-                              [beam_rapidity](const std::vector<double> &var){
-                                return var.at(0)-beam_rapidity;
-                              });
-  AnalysisTree::Variable efficiency("efficiency",
-                                    {{vtx_tracks, "rapidity"},
-                                     {vtx_tracks, "pT"}},
-                                    [beam_rapidity](const std::vector<double> &var){
-//                                      auto cent_class = HadesUtils::Centrality::GetClass(var.at(0),
-//                                                                              HadesUtils::DATA_TYPE::AuAu_1_23AGeV);
-//                                      if( cent_class > 7 )
-//                                        return 1.0;
-                                      auto y = var.at(0)-beam_rapidity;
-                                      auto pT = var.at(1);
-                                      auto eff = HadesUtils::Corrections::GetEfficiency(4, pT, y); // 20-25%
-                                      if( eff < 0.05 )
-                                        return 0.0;
-                                      if( eff > 1.0 )
-                                        return 0.0;
-                                      return 1.0/eff;
-                                    });
-
-  AnalysisTree::Variable y_cm_gen("y_cm_gen",
-                              {{sim_tracks, "rapidity"}},
-                              [beam_rapidity](const std::vector<double> &var){
-                                return var.at(0)-beam_rapidity;
+  // Per-track quantities are filled as fields of sim_tracks before the correction
+  auto* derived_fields = new HadesFlow::DerivedFieldsTask(sim_tracks);
+  derived_fields->AddField<1>("y_cm", {{sim_tracks, "rapidity"}},
+                              [beam_rapidity](const std::array<double, 1> &var){
+                                return var[0]-beam_rapidity;
                               });
+  HadesFlow::LastValue centrality_class([](double hits){
+    return HadesUtils::Centrality::GetClass(hits, HadesUtils::DATA_TYPE::AuAu_1_23AGeV);
+  });
+  if( efficiency_table && eff_options.centrality_class < 0 ){
+    derived_fields->AddField<3>("efficiency",
+                                {{event_header, "selected_tof_rpc_hits"},
+                                 {sim_tracks, "reco_rapidity"},
+                                 {sim_tracks, "reco_pT"}},
+                                [beam_rapidity, efficiency_table, centrality_class](const std::array<double, 3> &var) mutable {
+                                  auto cent_class = centrality_class(var[0]);
+                                  if( cent_class < 0 || cent_class > 7 )
+                                    return 1.0;
+                                  auto y = var[1]-beam_rapidity;
+                                  auto pT = var[2];
+                                  return efficiency_table->GetWeight(cent_class, pT, y);
+                                });
+  } else if( efficiency_table ){
+    derived_fields->AddField<2>("efficiency",
+                                {{sim_tracks, "reco_rapidity"},
+                                 {sim_tracks, "reco_pT"}},
+                                [beam_rapidity, efficiency_table, &eff_options](const std::array<double, 2> &var){
+                                  auto y = var[0]-beam_rapidity;
+                                  auto pT = var[1];
+                                  return efficiency_table->GetWeight(eff_options.centrality_class, pT, y);
+                                });
+  }
 
-  Qn::AxisConfig pt_axis({vtx_tracks, "pT"}, {0, 0.29375, 0.35625, 0.41875, 0.48125, 0.54375, 0.61875, 0.70625, 0.81875, 1.01875, 2.0});
   Qn::AxisConfig pt_axis_gen({sim_tracks, "pT"}, {0, 0.29375, 0.35625, 0.41875, 0.48125, 0.54375, 0.61875, 0.70625, 0.81875, 1.01875, 2.0});
-  Qn::AxisConfig rapidity_axis(y_cm, 15, -0.75, 0.75);
-  Qn::AxisConfig rapidity_axis_gen(y_cm_gen, 15, -0.75, 0.75);
+  Qn::AxisConfig rapidity_axis_gen(HadesFlow::NamedField("y_cm_gen", sim_tracks, "y_cm"), 15, -0.75, 0.75);
 
   auto* global_config = new Qn::GlobalConfig();
   global_config->AddEventVar(centrality);
   global_config->AddCorrectionAxis( {"Centrality", 8, 0.0, 40.0} );
+  HadesFlow::CutPlan cut_plan;
   // un-vector from MDC
 
+  // Reconstructed protons filled with their sim azimuth. The reco quantities are
+  // fields of sim_tracks copied from the matched reco track by MatchedFieldsTask.
+  const auto sim_proton_cut = HadesFlow::EqualsCut(sim_tracks, "geant_pid", 14.0, "cut on proton sim-pid");
+  const auto primary_cut = HadesFlow::EqualsCut(sim_tracks, "is_primary", 1.0, "cut on primary");
+  const auto reco_cut = HadesFlow::EqualsCut(sim_tracks, "is_reco", 1.0, "cut on reconstructed");
   Qn::QvectorTracksConfig pid_reco_eff("PID_Eff_Corr",
-                                  {sim_tracks, "phi"}, efficiency,
+                                  {sim_tracks, "phi"}, {sim_tracks, "efficiency"},
                                   {pt_axis_gen, rapidity_axis_gen});
   pid_reco_eff.SetCorrectionSteps(true, false, false);
-  pid_reco_eff.AddCut( {AnalysisTree::Variable(sim_tracks, "geant_pid"),
-                       [](double pid) { return abs(pid - 14.0) < 0.1; }, "PID_Eff_Corr, cut on proton reco-pid"});
-  pid_reco_eff.AddCut( {AnalysisTree::Variable(sim_tracks, "is_primary"),
-                       [](double pid) { return abs(pid - 1.0) < 0.1; }, "PID_Eff_Corr, cut on proton reco-pid"});
-  pid_reco_eff.AddCut( {AnalysisTree::Variable(vtx_tracks, "geant_pid"),
-                       [](double pid) { return true; }, "PID_Eff_Corr, cut on proton reco-pid"});
   pid_reco_eff.SetType(Qn::Stats::Weights::OBSERVABLE);
-//  global_config->AddTrackQvector(pid_reco_eff);
 
   Qn::QvectorTracksConfig pid_reco_no_eff("PID_No_Eff_Corr",
                                           {sim_tracks, "phi"}, {"Ones"},
                                           {pt_axis_gen, rapidity_axis_gen});
   pid_reco_no_eff.SetCorrectionSteps(true, false, false);
-  pid_reco_no_eff.AddCut( {AnalysisTree::Variable(sim_tracks, "geant_pid"),
-                        [](double pid) { return abs(pid - 14.0) < 0.1; }, "PID_Eff_Corr, cut on proton reco-pid"});
-  pid_reco_no_eff.AddCut( {AnalysisTree::Variable(sim_tracks, "is_primary"),
-                        [](double pid) { return abs(pid - 1.0) < 0.1; }, "PID_Eff_Corr, cut on proton reco-pid"});
-  pid_reco_no_eff.AddCut( {AnalysisTree::Variable(vtx_tracks, "geant_pid"),
-                        [](double pid) { return true; }, "PID_Eff_Corr, cut on proton reco-pid"});
   pid_reco_no_eff.SetType(Qn::Stats::Weights::OBSERVABLE);
-//  global_config->AddTrackQvector(pid_reco_no_eff);
+  if( eff_options.reco_qvectors ){
+    for( auto* qvector : {&pid_reco_eff, &pid_reco_no_eff} ){
+      cut_plan.AddQvector(*qvector, sim_tracks);
+      cut_plan.AddCut(*qvector, sim_proton_cut);
+      cut_plan.AddCut(*qvector, primary_cut);
+      cut_plan.AddCut(*qvector, reco_cut);
+    }
+  }
 
   Qn::QvectorTracksConfig gen_prim("GEN_Prim",
                                   {sim_tracks, "phi"}, {"Ones"},
                                   {pt_axis_gen, rapidity_axis_gen});
   gen_prim.SetCorrectionSteps(false, false, false);
-  gen_prim.AddCut({AnalysisTree::Variable(sim_tracks, "geant_pid"),
-                   [](double pid) { return abs(pid - 14.0) < 0.1; }, "GEN_Prim, cut on proton sim-pid"});
-  gen_prim.AddCut( {AnalysisTree::Variable(sim_tracks, "is_primary"),
-                    [](double pid) { return abs(pid - 1.0) < 0.1; }, "GEN_Prim, cut on primary"} );
+  cut_plan.AddQvector(gen_prim, sim_tracks);
+  cut_plan.AddCut(gen_prim, sim_proton_cut);
+  cut_plan.AddCut(gen_prim, primary_cut);
   gen_prim.SetType(Qn::Stats::Weights::OBSERVABLE);
-  global_config->AddTrackQvector(gen_prim);
 
   Qn::QvectorTracksConfig gen_sec("GEN_Sec",
                                   {sim_tracks, "phi"}, {"Ones"},
@@ -128,8 +139,15 @@ int main(int argc, char **argv) {
   gen_sec.AddCut( {AnalysisTree::Variable(sim_tracks, "is_primary"),
                     [](double pid) { return abs(pid - 0.0) < 0.1; }, "GEN_Sec, cut on is not primary"} );
   gen_sec.SetType(Qn::Stats::Weights::OBSERVABLE);
+  // Do not enable GEN_Sec by adding it to global_config directly: the primary cut
+  // of all Q-vectors known to cut_plan is applied as a sim_tracks branch cut and
+  // would remove every secondary. Register it with cut_plan.AddQvector() and its
+  // cuts with cut_plan.AddCut() instead.
 //  global_config->AddTrackQvector(gen_sec);
 
+  for( auto* qvector : cut_plan.Apply() )
+    global_config->AddTrackQvector(*qvector);
+
   Qn::QvectorConfig psi_rp("psi_rp", {sim_event, "reaction_plane"}, {"Ones"});
   psi_rp.SetCorrectionSteps(false, false, false);
   global_config->SetPsiQvector(psi_rp);
@@ -141,14 +159,99 @@ int main(int argc, char **argv) {
 
   task_manager.SetEventCuts(HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::EVENT_HEADER,
                                                   HadesUtils::DATA_TYPE::AuAu_1_23AGeV));
-  task_manager.AddBranchCut(HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::MDC_TRACKS,
-                                                  HadesUtils::DATA_TYPE::AuAu_1_23AGeV));
+  auto* vtx_cuts = HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::MDC_TRACKS,
+                                         HadesUtils::DATA_TYPE::AuAu_1_23AGeV);
+  task_manager.AddBranchCut(vtx_cuts);
   task_manager.AddBranchCut(HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::META_HITS,
                                                   HadesUtils::DATA_TYPE::AuAu_1_23AGeV));
+  if( auto* cuts = cut_plan.AddSharedCuts(sim_tracks, nullptr) )
+    task_manager.AddBranchCut(cuts);
 
+  if( eff_options.reco_qvectors )
+    task_manager.AddTask(new HadesFlow::MatchedFieldsTask(vtx_tracks, sim_tracks, {"rapidity", "pT"}, vtx_cuts));
+  // After the matched fields, which the efficiency reads and the masks may cut on
+  task_manager.AddTask(derived_fields);
+  for( auto* mask_task : cut_plan.MakeMaskTasks() )
+    task_manager.AddTask(mask_task);
   task_manager.AddTask(task);
-  task_manager.Init();
-  task_manager.Run(-1);
-  task_manager.Finish();
+  {
+    HadesFlow::ScopedStage stage("init");
+    task_manager.Init();
+  }
+  {
+    // Reading, event and branch cuts, Q-vector and QA filling, corrections
+    HadesFlow::ScopedStage stage("event loop");
+    task_manager.Run(-1);
+  }
+  {
+    HadesFlow::ScopedStage stage("finish");
+    task_manager.Finish();
+  }
+  HadesFlow::CountEvents(HadesFlow::ReadFileList(file_list), "hades_analysis_tree");
+}
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+  if(argc < 2){
+    std::cout << "Error! Please use " << std::endl;
+    std::cout << " ./correct filelist.txt path/to/efficiency.root" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  std::string file_list;
+  EfficiencyOptions eff_options;
+  HadesFlow::PassOptions pass_options;
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("input,i", po::value<std::string>(&file_list), "Set path to input file list")
+      ("efficiency,e", po::value<std::string>(&eff_options.file), "Set path to efficiency maps")
+      ("centrality-class", po::value<int>(&eff_options.centrality_class)->default_value(-1),
+       "Centrality class of the efficiency maps, -1 to take it from each event")
+      ("eff-interpolate", po::bool_switch(&eff_options.interpolate),
+       "Interpolate the efficiency weights between the map cells")
+      ("reco-qvectors", po::bool_switch(&eff_options.reco_qvectors),
+       "Fill the reconstructed protons PID_Eff_Corr and PID_No_Eff_Corr from the reco-sim matching");
+  HadesFlow::AddPassOptions(options, pass_options);
+  po::positional_options_description positional;
+  positional.add("input", 1).add("efficiency", 1);
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+  // 8 classes of 5% up to 40% centrality in the efficiency maps
+  const int n_centrality_classes = 8;
+  if( eff_options.centrality_class < -1 || eff_options.centrality_class >= n_centrality_classes )
+    throw std::runtime_error("Centrality class must be between -1 and " + std::to_string(n_centrality_classes - 1));
+
+  // meta_hits is only read by the HadesUtils branch cuts and is kept whole
+  const HadesFlow::FieldList used_fields{
+      {"event_header", "selected_tof_rpc_hits"},
+      {"mdc_vtx_tracks", "pT"}, {"mdc_vtx_tracks", "rapidity"},
+      {"mdc_vtx_tracks", "geant_pid"},
+      {"sim_tracks", "phi"}, {"sim_tracks", "pT"}, {"sim_tracks", "rapidity"},
+      {"sim_tracks", "geant_pid"}, {"sim_tracks", "is_primary"},
+      {"sim_header", "reaction_plane"},
+      {"meta_hits", "*"}};
+  HadesUtils::Corrections::ReadMaps(eff_options.file);
+  // Sampling the maps takes 8x400x300 calls, done once for all passes and chunks
+  // and only if a Q-vector is weighted with them.
+  std::unique_ptr<HadesFlow::EfficiencyTable> efficiency_table;
+  if( eff_options.reco_qvectors ){
+    efficiency_table = std::make_unique<HadesFlow::EfficiencyTable>(HadesUtils::Corrections::GetEfficiency,
+                                                                        n_centrality_classes);
+    efficiency_table->SetInterpolation(eff_options.interpolate);
+  }
+  pass_options.config = "efficiency " + eff_options.file +
+                        " centrality-class " + std::to_string(eff_options.centrality_class) +
+                        " eff-interpolate " + std::to_string(eff_options.interpolate) +
+                        " reco-qvectors " + std::to_string(eff_options.reco_qvectors);
+  HadesFlow::RunPasses(pass_options, file_list, used_fields,
+                       [&eff_options, &efficiency_table](const std::string& list, int){
+                         Correct(list, eff_options, efficiency_table.get());
+                       });
   return 0;
 }
@@ -1,11 +1,17 @@
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 #include <string>
+#include <boost/program_options.hpp>
 
 #include <CorrelationTask.h>
 
+#include <common/correlator.h>
+#include <common/perf.h>
+
 int main(int argc, char **argv) {
   using namespace std;
+  namespace po = boost::program_options;
 
   if(argc < 2){
     std::cout << "Error! Please use " << std::endl;
@@ -13,16 +19,62 @@ int main(int argc, char **argv) {
     exit(EXIT_FAILURE);
   }
 
-  const std::string& file{argv[1]};
-  CorrelationTask st(file, "tree");
-  st.SetNonZeroOnly(true);
-//  st.AddQ2Q2Correlation("PID_Eff_Corr", "psi_rp");
-//  st.AddQ2Q2Correlation("PID_No_Eff_Corr", "psi_rp");
+  std::string file;
+  std::string output;
+  unsigned int n_threads{0};
+  std::string perf_json;
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("input,i", po::value<std::string>(&file), "Set path to the file with corrected Q-vectors")
+      ("output,o", po::value<std::string>(&output)->default_value("correlation.root"),
+       "Output file of the correlations")
+      ("threads,t", po::value<unsigned int>(&n_threads)->default_value(0),
+       "Number of threads of the correlation event loop, 0 for a single thread")
+      ("correlation-task", "Also run CorrelationTask of Flow, single-threaded, for its output format")
+      ("perf-json", po::value<std::string>(&perf_json),
+       "Write the time per stage, events/s, bytes read and peak RSS to this JSON file");
+  po::positional_options_description positional;
+  positional.add("input", 1);
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+  if( !perf_json.empty() )
+    HadesFlow::Perf::Get().Enable();
+
+  // All correlations are registered before Run(), which reads every Q-vector once
+  // per event for all of them, the events split into blocks over n_threads threads
+  HadesFlow::Correlator correlator(file, "tree");
+  correlator.SetNonZeroOnly(true);
+  correlator.SetObservable("PID_Eff_Corr");
+  correlator.SetObservable("PID_No_Eff_Corr");
+//  correlator.AddCorrelation("PID_Eff_Corr", "psi_rp", HadesFlow::Product::kScalar, 2);
+//  correlator.AddCorrelation("PID_No_Eff_Corr", "psi_rp", HadesFlow::Product::kScalar, 2);
 
   auto start = std::chrono::system_clock::now();
-  st.Run();
+  {
+    HadesFlow::ScopedStage stage("event loop");
+    correlator.Run(std::max(1u, n_threads));
+    correlator.Write(output);
+  }
   auto end = std::chrono::system_clock::now();
   std::chrono::duration<double> elapsed_seconds = end - start;
   std::cout << "elapsed time: " << elapsed_seconds.count() << " s\n";
+  if( vm.count("correlation-task") ){
+    HadesFlow::ScopedStage stage("correlation task");
+    CorrelationTask st(file, "tree");
+    st.SetNonZeroOnly(true);
+//    st.AddQ2Q2Correlation("PID_Eff_Corr", "psi_rp");
+//    st.AddQ2Q2Correlation("PID_No_Eff_Corr", "psi_rp");
+    st.Run();
+  }
+  if( !perf_json.empty() ){
+    HadesFlow::CountEvents({file}, "tree");
+    HadesFlow::Perf::Get().WriteJson(perf_json);
+  }
   return 0;
 }
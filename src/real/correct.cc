@@ -9,30 +9,27 @@
 
 #include <cuts.h>
 
-int main(int argc, char **argv) {
-  using namespace std;
-  namespace po = boost::program_options;
-  if(argc < 2){
-    throw std::runtime_error("No arguments were provided. Use ./correct --help to get more information.");
-  }
+#include <common/cut_plan.h>
+#include <common/derived_fields.h>
+#include <common/file_list.h>
+#include <common/hash.h>
+#include <common/passes.h>
+#include <common/perf.h>
+#include <common/variables.h>
 
-  std::string file_list;
-  po::options_description options("Options");
-  options.add_options()
-      ("help,h", "Help screen")
-      ("debug,d", "Debug option: 1K events, no corrections of Q-vectors")
-      ("input,i", po::value<std::string>(&file_list),
-       "Set path to input configuration");
-  po::variables_map vm;
-  po::parsed_options parsed = po::command_line_parser(argc, argv).options(options).run();
-  po::store(parsed, vm);
-  po::notify(vm);
-  if (vm.count("help")){
-    std::cout << options << std::endl;
-    return 0;
-  }
-  bool is_debug=vm.count("debug");
+struct SubEventOptions {
+  int partitions{0};
+  uint64_t seed{1};
+};
 
+struct QaOptions {
+  int pass{0};
+  // Fraction of the events filling the QA histograms
+  double fraction{1.0};
+};
+
+void Correct(const std::string& file_list, bool is_debug, const SubEventOptions& sub_events, double qa_fraction){
+  using namespace std;
   const string event_header = "event_header";
   const string vtx_tracks = "mdc_vtx_tracks";
   const string wall_hits = "forward_wall_hits";
@@ -40,17 +37,22 @@ int main(int argc, char **argv) {
   double beam_rapidity = AnalysisTree::GetObjectFromFileList<AnalysisTree::DataHeader>(file_list, "DataHeader")->GetBeamRapidity();
   std::string system = AnalysisTree::GetObjectFromFileList<AnalysisTree::DataHeader>(file_list, "DataHeader")->GetSystem();
 
-  AnalysisTree::Variable y_cm("y_cm",
-                              {{vtx_tracks, "rapidity"}},
-                              [beam_rapidity](const std::vector<double> &var){
-                                return var.at(0)-beam_rapidity;
-                              });
+  // Per-track quantities are filled as fields before the correction
+  auto* vtx_fields = new HadesFlow::DerivedFieldsTask(vtx_tracks);
+  vtx_fields->AddField<1>("y_cm", {{vtx_tracks, "rapidity"}},
+                          [beam_rapidity](const std::array<double, 1> &var){
+                            return var[0]-beam_rapidity;
+                          });
+  HadesFlow::DerivedFieldsTask* wall_fields{nullptr};
 
   Qn::AxisConfig pt_axis({vtx_tracks, "pT"}, 20, 0.0, 2.0);
-  Qn::AxisConfig rapidity_axis(y_cm, 15, -0.75, 0.75);
+  Qn::AxisConfig rapidity_axis(HadesFlow::NamedField("y_cm", vtx_tracks, "y_cm"), 15, -0.75, 0.75);
   auto* global_config = new Qn::GlobalConfig();
   global_config->AddEventVar({event_header, "selected_tof_rpc_hits_centrality"});
   global_config->AddCorrectionAxis( {"event_header_selected_tof_rpc_hits_centrality", 8, 0.0, 40.0} );
+  HadesFlow::CutPlan cut_plan;
+  const auto proton_cut = HadesFlow::EqualsCut(vtx_tracks, "geant_pid", 14.0, "cut on proton pid");
+  const auto pt_cut = HadesFlow::OpenRangeCut(vtx_tracks, "pT", 0.0, 2.0, "forward cut");
   // un-vector from MDC
   Qn::QvectorTracksConfig un_vector("u",{vtx_tracks, "phi"}, {"Ones"},
                                     {pt_axis,rapidity_axis});
@@ -58,10 +60,27 @@ int main(int argc, char **argv) {
   if( is_debug )
     un_vector.SetCorrectionSteps(false, false, false);
 
-  un_vector.AddCut({AnalysisTree::Variable("mdc_vtx_tracks", "geant_pid"),
-                    [](double pid) { return abs(pid - 14.0) < 0.1; }, "cut on proton pid"});
+  cut_plan.AddQvector(un_vector, vtx_tracks);
+  cut_plan.AddCut(un_vector, proton_cut);
   un_vector.SetType(Qn::Stats::Weights::OBSERVABLE);
-  global_config->AddTrackQvector(un_vector);
+
+  // QA from a subsample of the events: the tracks of u in the sampled events fill a
+  // QA-only Q-vector without axes and corrections. The sample is drawn from a hash of
+  // the event number, so every pass over the same input picks the same events.
+  std::string qa_qvector = "u";
+  Qn::QvectorTracksConfig un_qa("u_qa", {vtx_tracks, "phi"}, {"Ones"}, {});
+  un_qa.SetCorrectionSteps(false, false, false);
+  if( qa_fraction > 0.0 && qa_fraction < 1.0 ){
+    vtx_fields->AddField<1>("qa_sample", {{vtx_tracks, HadesFlow::DerivedFieldsTask::kEventNumber}},
+                            [qa_fraction](const std::array<double, 1> &var){
+                              auto uniform = (HadesFlow::Mix(static_cast<uint64_t>(var[0])) >> 11) * 0x1.0p-53;
+                              return uniform < qa_fraction ? 1.0 : 0.0;
+                            });
+    cut_plan.AddQvector(un_qa, vtx_tracks);
+    cut_plan.AddCut(un_qa, proton_cut);
+    cut_plan.AddCut(un_qa, HadesFlow::EqualsCut(vtx_tracks, "qa_sample", 1.0, "cut on QA events"));
+    qa_qvector = un_qa.GetName();
+  }
 
   // Q-vectors from Forward Wall
   Qn::QvectorTracksConfig qn_wall_1("W1", {wall_hits, "phi"},
@@ -69,60 +88,73 @@ int main(int argc, char **argv) {
   qn_wall_1.SetCorrectionSteps(true, true, true);
   if( is_debug )
     qn_wall_1.SetCorrectionSteps(false, false, false);
-  qn_wall_1.AddCut({{wall_hits, "ring"},
-                    [](double value) { return 1.0 <= value && value <= 5.0; }, "cut on first SE"});
-  qn_wall_1.AddCut({{wall_hits, "beta"},
-                    [](double value) { return 0.84 <= value && value <= 1.0; }, "cut on beta first SE"});
-  qn_wall_1.AddCut({{wall_hits, "signal"},
-                    [](double value) { return 80.0 <= value && value <= 999.0; }, "cut on signal first SE"});
+  cut_plan.AddQvector(qn_wall_1, wall_hits);
+  cut_plan.AddCut(qn_wall_1, HadesFlow::RangeCut(wall_hits, "ring", 1.0, 5.0, "cut on first SE"));
+  cut_plan.AddCut(qn_wall_1, HadesFlow::RangeCut(wall_hits, "beta", 0.84, 1.0, "cut on beta first SE"));
+  cut_plan.AddCut(qn_wall_1, HadesFlow::RangeCut(wall_hits, "signal", 80.0, 999.0, "cut on signal first SE"));
   qn_wall_1.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_wall_1);
 
   Qn::QvectorTracksConfig qn_wall_2("W2", {wall_hits, "phi"},
                                        {wall_hits, "signal"},{});
   qn_wall_2.SetCorrectionSteps(true, true, true);
   if( is_debug )
     qn_wall_2.SetCorrectionSteps(false, true, true);
-  qn_wall_2.AddCut({{wall_hits, "ring"},
-                    [](double value) { return 6.0 <= value && value <= 7.0; }, "cut on second SE"});
-  qn_wall_2.AddCut({{wall_hits, "beta"},
-                    [](double value) { return 0.85 <= value && value <= 1.0; }, "cut on beta second SE"});
-  qn_wall_2.AddCut({{wall_hits, "signal"},
-                    [](double value) { return 85.0 <= value && value <= 999.0; }, "cut on signal second SE"});
+  cut_plan.AddQvector(qn_wall_2, wall_hits);
+  cut_plan.AddCut(qn_wall_2, HadesFlow::RangeCut(wall_hits, "ring", 6.0, 7.0, "cut on second SE"));
+  cut_plan.AddCut(qn_wall_2, HadesFlow::RangeCut(wall_hits, "beta", 0.85, 1.0, "cut on beta second SE"));
+  cut_plan.AddCut(qn_wall_2, HadesFlow::RangeCut(wall_hits, "signal", 85.0, 999.0, "cut on signal second SE"));
   qn_wall_2.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_wall_2);
 
   Qn::QvectorTracksConfig qn_wall_3("W3", {wall_hits, "phi"},
                                        {wall_hits, "signal"},{});
   qn_wall_3.SetCorrectionSteps(true, true, true);
   if( is_debug )
     qn_wall_3.SetCorrectionSteps(false, false, false);
-  qn_wall_3.AddCut({{wall_hits, "ring"},
-                      [](double value){ return 8.0 <= value && value <= 10.0;}, "cut on third SE"});
-  qn_wall_3.AddCut({{wall_hits, "beta"},
-                    [](double value) { return 0.80 <= value && value <= 1.0; }, "cut on beta third SE"});
-  qn_wall_3.AddCut({{wall_hits, "signal"},
-                    [](double value) { return 88.0 <= value && value <= 999.0; }, "cut on signal third SE"});
+  cut_plan.AddQvector(qn_wall_3, wall_hits);
+  cut_plan.AddCut(qn_wall_3, HadesFlow::RangeCut(wall_hits, "ring", 8.0, 10.0, "cut on third SE"));
+  cut_plan.AddCut(qn_wall_3, HadesFlow::RangeCut(wall_hits, "beta", 0.80, 1.0, "cut on beta third SE"));
+  cut_plan.AddCut(qn_wall_3, HadesFlow::RangeCut(wall_hits, "signal", 88.0, 999.0, "cut on signal third SE"));
   qn_wall_3.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_wall_3);
 
-  Qn::QvectorTracksConfig qn_rs1("R1", {wall_hits, "phi"},
-                                       {wall_hits, "signal"},{});
-  qn_rs1.SetCorrectionSteps(true, false, false);
-  if( is_debug )
-    qn_rs1.SetCorrectionSteps(false, false, false);
-  qn_rs1.AddCut({{wall_hits, "rnd_sub"},
-                      [](double value){ return fabs(value - 0.0) < 0.1;},"cut on first RND-SE"});
-  qn_rs1.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_rs1);
-  Qn::QvectorTracksConfig qn_rs2("R2", {wall_hits, "phi"},
-                                       {wall_hits, "signal"},{});
-  qn_rs2.SetCorrectionSteps(true, false, false);
-  if( is_debug )
-    qn_rs2.SetCorrectionSteps(false, false, false);
-  qn_rs2.AddCut({{wall_hits, "rnd_sub"},
-                      [](double value){ return fabs(value - 1.0) < 0.1;}, "cut on second RND-SE"});
-  global_config->AddTrackQvector(qn_rs2);
+  // Random sub-events: either the rnd_sub field of the input or sub_events.partitions
+  // independent splits drawn per hit from a hash of the event number, the hit index
+  // and its phi, signal and beta. The hash needs no random state, so the splits are
+  // reproducible for a seed and the same input.
+  // As before the splits, only the first half is declared a reference Q-vector.
+  std::vector<Qn::QvectorTracksConfig> rnd_qvectors;
+  rnd_qvectors.reserve(2 * std::max(sub_events.partitions, 1));   // the cut plan keeps pointers
+  auto add_rnd_qvector = [&](const std::string& name, bool reference) -> Qn::QvectorTracksConfig& {
+    auto& qvector = rnd_qvectors.emplace_back(name, AnalysisTree::Variable(wall_hits, "phi"),
+                                              AnalysisTree::Variable(wall_hits, "signal"),
+                                              std::vector<Qn::AxisConfig>{});
+    qvector.SetCorrectionSteps(true, false, false);
+    if( is_debug )
+      qvector.SetCorrectionSteps(false, false, false);
+    if( reference )
+      qvector.SetType(Qn::Stats::Weights::REFERENCE);
+    cut_plan.AddQvector(qvector, wall_hits);
+    return qvector;
+  };
+  if( sub_events.partitions == 0 ){
+    cut_plan.AddCut(add_rnd_qvector("R1", true), HadesFlow::EqualsCut(wall_hits, "rnd_sub", 0.0, "cut on first RND-SE"));
+    cut_plan.AddCut(add_rnd_qvector("R2", false), HadesFlow::EqualsCut(wall_hits, "rnd_sub", 1.0, "cut on second RND-SE"));
+  }
+  for( int k=0; k<sub_events.partitions; ++k ){
+    const auto seed = HadesFlow::Mix(sub_events.seed) + k;
+    const auto rnd_sub = "rnd_sub_" + std::to_string(k);
+    if( !wall_fields )
+      wall_fields = new HadesFlow::DerivedFieldsTask(wall_hits);
+    wall_fields->AddField<5>(rnd_sub, {{wall_hits, HadesFlow::DerivedFieldsTask::kEventNumber},
+                                       {wall_hits, HadesFlow::DerivedFieldsTask::kChannelIndex},
+                                       {wall_hits, "phi"}, {wall_hits, "signal"}, {wall_hits, "beta"}},
+                             [seed](const std::array<double, 5> &var){
+                               return static_cast<double>(HadesFlow::Hash(seed, var) & 1);
+                             });
+    cut_plan.AddCut(add_rnd_qvector("R1_" + std::to_string(k), true),
+                    HadesFlow::EqualsCut(wall_hits, rnd_sub, 0.0, "cut on first RND-SE " + std::to_string(k)));
+    cut_plan.AddCut(add_rnd_qvector("R2_" + std::to_string(k), false),
+                    HadesFlow::EqualsCut(wall_hits, rnd_sub, 1.0, "cut on second RND-SE " + std::to_string(k)));
+  }
 
   Qn::QvectorTracksConfig qn_full("F", {wall_hits, "phi"},
                                        {wall_hits, "signal"},{});
@@ -130,7 +162,7 @@ int main(int argc, char **argv) {
   if( is_debug )
     qn_full.SetCorrectionSteps(false, false, false);
   qn_full.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_full);
+  cut_plan.AddQvector(qn_full, wall_hits);
   // Q-vector from MDC
   Qn::QvectorTracksConfig qn_mdc_f("Mf",
                                     {vtx_tracks, "phi"},
@@ -138,14 +170,11 @@ int main(int argc, char **argv) {
   qn_mdc_f.SetCorrectionSteps(true, true, true);
   if( is_debug )
     qn_mdc_f.SetCorrectionSteps(false, false, false);
-  qn_mdc_f.AddCut( {AnalysisTree::Variable("mdc_vtx_tracks", "geant_pid"),
-                    [](double pid) { return abs(pid - 14.0) < 0.1; }, "proton cut"} );
-  qn_mdc_f.AddCut( {AnalysisTree::Variable("mdc_vtx_tracks", "rapidity"),
-                    [](double rapidity) { return 1.09 < rapidity && rapidity < 1.29; }, "forward cut"} );
-  qn_mdc_f.AddCut( {AnalysisTree::Variable("mdc_vtx_tracks", "pT"),
-                    [](double pT) { return 0.0 < pT && pT < 2.0; }, "forward cut"} );
+  cut_plan.AddQvector(qn_mdc_f, vtx_tracks);
+  cut_plan.AddCut(qn_mdc_f, proton_cut);
+  cut_plan.AddCut(qn_mdc_f, HadesFlow::OpenRangeCut(vtx_tracks, "rapidity", 1.09, 1.29, "forward cut"));
+  cut_plan.AddCut(qn_mdc_f, pt_cut);
   qn_mdc_f.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_mdc_f);
 
   Qn::QvectorTracksConfig qn_mdc_b("Mb",
                                     {vtx_tracks, "phi"},
@@ -153,14 +182,14 @@ int main(int argc, char **argv) {
   qn_mdc_b.SetCorrectionSteps(true, true, true);
   if( is_debug )
     qn_mdc_b.SetCorrectionSteps(false, false, false);
-  qn_mdc_b.AddCut( {AnalysisTree::Variable("mdc_vtx_tracks", "geant_pid"),
-                    [](double pid) { return abs(pid - 14.0) < 0.1; }, "proton cut"} );
-  qn_mdc_b.AddCut( {AnalysisTree::Variable("mdc_vtx_tracks", "rapidity"),
-                    [](double rapidity) { return 0.19 < rapidity && rapidity < 0.39; }, "backward cut"} );
-  qn_mdc_b.AddCut( {AnalysisTree::Variable("mdc_vtx_tracks", "pT"),
-                    [](double pT) { return 0.0 < pT && pT < 2.0; }, "forward cut"} );
+  cut_plan.AddQvector(qn_mdc_b, vtx_tracks);
+  cut_plan.AddCut(qn_mdc_b, proton_cut);
+  cut_plan.AddCut(qn_mdc_b, HadesFlow::OpenRangeCut(vtx_tracks, "rapidity", 0.19, 0.39, "backward cut"));
+  cut_plan.AddCut(qn_mdc_b, pt_cut);
   qn_mdc_b.SetType(Qn::Stats::Weights::REFERENCE);
-  global_config->AddTrackQvector(qn_mdc_b);
+
+  for( auto* qvector : cut_plan.Apply() )
+    global_config->AddTrackQvector(*qvector);
 
  // ***********************************************
   // first filelist should contain DataHeader
@@ -170,22 +199,24 @@ int main(int argc, char **argv) {
 
   AnalysisTree::Variable eta(vtx_tracks, "eta");
 
-  task->AddQAHistogram("u", {{"y_cm", 200, -0.75+beam_rapidity, 0.75+beam_rapidity},
-                           {vtx_tracks + "_pT", 200, 0.0, 2.0}});
+  if( qa_fraction > 0.0 ){
+    task->AddQAHistogram(qa_qvector, {{"y_cm", 200, -0.75+beam_rapidity, 0.75+beam_rapidity},
+                                      {vtx_tracks + "_pT", 200, 0.0, 2.0}});
 
-  task->AddQAHistogram("u", {{vtx_tracks + "_pT", 200, 0.0, 2.0},
-                             {vtx_tracks + "_phi", 315, -3.15, 3.15}});
+    task->AddQAHistogram(qa_qvector, {{vtx_tracks + "_pT", 200, 0.0, 2.0},
+                                      {vtx_tracks + "_phi", 315, -3.15, 3.15}});
 
-  task->AddQAHistogram("u", {{"y_cm", 100, -0.75+beam_rapidity, 0.75+beam_rapidity},
-                           {vtx_tracks + "_phi", 315, -3.15, 3.15}});
+    task->AddQAHistogram(qa_qvector, {{"y_cm", 100, -0.75+beam_rapidity, 0.75+beam_rapidity},
+                                      {vtx_tracks + "_phi", 315, -3.15, 3.15}});
+  }
 
+  AnalysisTree::Cuts* vtx_cuts{nullptr};
   if( system == "Au+Au" ) {
     task_manager.SetEventCuts(
         HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::EVENT_HEADER,
                               HadesUtils::DATA_TYPE::AuAu_1_23AGeV));
-    task_manager.AddBranchCut(
-        HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::MDC_TRACKS,
-                              HadesUtils::DATA_TYPE::AuAu_1_23AGeV));
+    vtx_cuts = HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::MDC_TRACKS,
+                                     HadesUtils::DATA_TYPE::AuAu_1_23AGeV);
     task_manager.AddBranchCut(
         HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::META_HITS,
                               HadesUtils::DATA_TYPE::AuAu_1_23AGeV));
@@ -196,9 +227,8 @@ int main(int argc, char **argv) {
     task_manager.SetEventCuts(
         HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::EVENT_HEADER,
                               HadesUtils::DATA_TYPE::AgAg_1_23AGeV));
-    task_manager.AddBranchCut(
-        HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::MDC_TRACKS,
-                              HadesUtils::DATA_TYPE::AgAg_1_23AGeV));
+    vtx_cuts = HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::MDC_TRACKS,
+                                     HadesUtils::DATA_TYPE::AgAg_1_23AGeV);
     task_manager.AddBranchCut(
         HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::META_HITS,
                               HadesUtils::DATA_TYPE::AgAg_1_23AGeV));
@@ -206,12 +236,97 @@ int main(int argc, char **argv) {
 //        HadesUtils::Cuts::Get(HadesUtils::Cuts::BRANCH_TYPE::WALL_HITS,
 //                              HadesUtils::DATA_TYPE::AgAg_1_23AGeV));
   }
+  if( auto* cuts = cut_plan.AddSharedCuts(vtx_tracks, vtx_cuts) )
+    task_manager.AddBranchCut(cuts);
+  if( auto* cuts = cut_plan.AddSharedCuts(wall_hits, nullptr) )
+    task_manager.AddBranchCut(cuts);
+  task_manager.AddTask(vtx_fields);
+  if( wall_fields )
+    task_manager.AddTask(wall_fields);
+  for( auto* mask_task : cut_plan.MakeMaskTasks() )
+    task_manager.AddTask(mask_task);
   task_manager.AddTask(task);
-  task_manager.Init();
-  if( is_debug )
-    task_manager.Run(10000);
-  else
-    task_manager.Run(-1);
-  task_manager.Finish();
+  {
+    HadesFlow::ScopedStage stage("init");
+    task_manager.Init();
+  }
+  {
+    // Reading, event and branch cuts, Q-vector and QA filling, corrections
+    HadesFlow::ScopedStage stage("event loop");
+    if( is_debug )
+      task_manager.Run(10000);
+    else
+      task_manager.Run(-1);
+  }
+  {
+    HadesFlow::ScopedStage stage("finish");
+    task_manager.Finish();
+  }
+  HadesFlow::CountEvents(HadesFlow::ReadFileList(file_list), "hades_analysis_tree", is_debug ? 10000 : -1);
+}
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+  if(argc < 2){
+    throw std::runtime_error("No arguments were provided. Use ./correct --help to get more information.");
+  }
+
+  std::string file_list;
+  SubEventOptions sub_events;
+  QaOptions qa;
+  HadesFlow::PassOptions pass_options;
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("debug,d", "Debug option: 1K events, no corrections of Q-vectors")
+      ("input,i", po::value<std::string>(&file_list),
+       "Set path to input configuration")
+      ("rnd-partitions", po::value<int>(&sub_events.partitions)->default_value(0),
+       "Number of random splits of the wall hits into R1_k/R2_k, 0 to use the rnd_sub field as R1/R2")
+      ("rnd-seed", po::value<uint64_t>(&sub_events.seed)->default_value(1),
+       "Seed of the random splits")
+      ("qa-pass", po::value<int>(&qa.pass)->default_value(0),
+       "Pass filling the QA histograms, counted from 1; 0 for the last pass, -1 for none")
+      ("qa-fraction", po::value<double>(&qa.fraction)->default_value(1.0),
+       "Fraction of the events filling the QA histograms, drawn by event number; below 1 they are filled from u_qa");
+  HadesFlow::AddPassOptions(options, pass_options);
+  po::variables_map vm;
+  po::parsed_options parsed = po::command_line_parser(argc, argv).options(options).run();
+  po::store(parsed, vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+  bool is_debug=vm.count("debug");
+  if( sub_events.partitions < 0 )
+    throw std::runtime_error("Number of random partitions must not be negative");
+  if( qa.pass < -1 || qa.pass > pass_options.iterations )
+    throw std::runtime_error("QA pass must be between -1 and the number of iterations");
+  if( !(qa.fraction > 0.0 && qa.fraction <= 1.0) )
+    throw std::runtime_error("QA fraction must be in (0, 1]");
+
+  // meta_hits is only read by the HadesUtils branch cuts and is kept whole
+  HadesFlow::FieldList used_fields{
+      {"event_header", "selected_tof_rpc_hits_centrality"},
+      {"mdc_vtx_tracks", "phi"}, {"mdc_vtx_tracks", "pT"},
+      {"mdc_vtx_tracks", "rapidity"}, {"mdc_vtx_tracks", "geant_pid"},
+      {"forward_wall_hits", "phi"}, {"forward_wall_hits", "signal"},
+      {"forward_wall_hits", "ring"}, {"forward_wall_hits", "beta"},
+      {"meta_hits", "*"}};
+  if( sub_events.partitions == 0 )
+    used_fields.emplace_back("forward_wall_hits", "rnd_sub");
+  // QA is only inspected from one pass, the others skip it
+  if( qa.pass == 0 )
+    qa.pass = pass_options.iterations;
+  pass_options.config = "debug " + std::to_string(is_debug) +
+                        " rnd-partitions " + std::to_string(sub_events.partitions) +
+                        " rnd-seed " + std::to_string(sub_events.seed) +
+                        " qa-pass " + std::to_string(qa.pass) +
+                        " qa-fraction " + std::to_string(qa.fraction);
+  HadesFlow::RunPasses(pass_options, file_list, used_fields,
+                       [is_debug, &sub_events, &qa](const std::string& list, int pass){
+                         Correct(list, is_debug, sub_events, pass+1 == qa.pass ? qa.fraction : 0.0);
+                       });
   return 0;
 }
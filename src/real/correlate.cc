@@ -1,11 +1,39 @@
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
+#include <boost/program_options.hpp>
 
 #include <CorrelationTask.h>
 
+#include <common/correlator.h>
+#include <common/perf.h>
+
+using CorrelationType = decltype(CorrelationTask::SCALAR_PRODUCT);
+
+struct Correlation {
+  std::string first;
+  std::string second;
+  CorrelationType type;
+};
+
+HadesFlow::Product GetProduct(CorrelationType type) {
+  switch( type ){
+    case CorrelationTask::SCALAR_PRODUCT:
+      return HadesFlow::Product::kScalar;
+    case CorrelationTask::u1Q1_EVENT_PLANE:
+      return HadesFlow::Product::kEventPlane;
+    case CorrelationTask::Q1Q1_EVENT_PLANE:
+      return HadesFlow::Product::kBothEventPlane;
+  }
+  throw std::runtime_error("Correlation type not supported by the correlator");
+}
+
 int main(int argc, char **argv) {
   using namespace std;
+  namespace po = boost::program_options;
 
   if(argc < 2){
     std::cout << "Error! Please use " << std::endl;
@@ -13,36 +41,99 @@ int main(int argc, char **argv) {
     exit(EXIT_FAILURE);
   }
 
-  const std::string& file{argv[1]};
-  CorrelationTask st(file, "tree");
-  st.SetNonZeroOnly(false);
+  std::string file;
+  std::string output;
+  unsigned int n_threads{0};
+  std::string perf_json;
+  int n_samples{0};
+  int rnd_partitions{0};
+  uint64_t bootstrap_seed{1};
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("input,i", po::value<std::string>(&file), "Set path to the file with corrected Q-vectors")
+      ("output,o", po::value<std::string>(&output)->default_value("correlation.root"),
+       "Output file of the correlations")
+      ("threads,t", po::value<unsigned int>(&n_threads)->default_value(0),
+       "Number of threads of the correlation event loop, 0 for a single thread")
+      ("correlation-task", "Also run CorrelationTask of Flow, single-threaded, for its output format")
+      ("perf-json", po::value<std::string>(&perf_json),
+       "Write the time per stage, events/s, bytes read and peak RSS to this JSON file")
+      ("rnd-partitions", po::value<int>(&rnd_partitions)->default_value(0),
+       "Number of random sub-event splits R1_k/R2_k made by correct, 0 for R1/R2")
+      ("bootstrap,b", po::value<int>(&n_samples)->default_value(0),
+       "Number of Poisson bootstrap samples filled in the correlation loop and written next to the means, 0 to skip")
+      ("bootstrap-seed", po::value<uint64_t>(&bootstrap_seed)->default_value(1),
+       "Seed of the bootstrap weights");
+  po::positional_options_description positional;
+  positional.add("input", 1);
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+  if( !perf_json.empty() )
+    HadesFlow::Perf::Get().Enable();
 
-  st.AddQ1Q1Correlation("u", "W1", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("u", "W2", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("u", "W3", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("u", "Mf", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("u", "Mb", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("u", "F", CorrelationTask::u1Q1_EVENT_PLANE);
+  // Shared by the correlator and CorrelationTask
+  std::vector<Correlation> correlations{
+      {"u", "W1", CorrelationTask::SCALAR_PRODUCT},
+      {"u", "W2", CorrelationTask::SCALAR_PRODUCT},
+      {"u", "W3", CorrelationTask::SCALAR_PRODUCT},
+      {"u", "Mf", CorrelationTask::SCALAR_PRODUCT},
+      {"u", "Mb", CorrelationTask::SCALAR_PRODUCT},
+      {"u", "F", CorrelationTask::u1Q1_EVENT_PLANE},
 
-  st.AddQ1Q1Correlation("W1", "W2", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("W1", "W3", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("W2", "W3", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("R1", "R2", CorrelationTask::Q1Q1_EVENT_PLANE);
+      {"W1", "W2", CorrelationTask::SCALAR_PRODUCT},
+      {"W1", "W3", CorrelationTask::SCALAR_PRODUCT},
+      {"W2", "W3", CorrelationTask::SCALAR_PRODUCT},
 
-  st.AddQ1Q1Correlation("Mf", "W1", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("Mf", "W2", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("Mf", "W3", CorrelationTask::SCALAR_PRODUCT);
+      {"Mf", "W1", CorrelationTask::SCALAR_PRODUCT},
+      {"Mf", "W2", CorrelationTask::SCALAR_PRODUCT},
+      {"Mf", "W3", CorrelationTask::SCALAR_PRODUCT},
 
-  st.AddQ1Q1Correlation("Mb", "W1", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("Mb", "W2", CorrelationTask::SCALAR_PRODUCT);
-  st.AddQ1Q1Correlation("Mb", "W3", CorrelationTask::SCALAR_PRODUCT);
+      {"Mb", "W1", CorrelationTask::SCALAR_PRODUCT},
+      {"Mb", "W2", CorrelationTask::SCALAR_PRODUCT},
+      {"Mb", "W3", CorrelationTask::SCALAR_PRODUCT},
 
-  st.AddQ1Q1Correlation("Mf", "Mb", CorrelationTask::SCALAR_PRODUCT);
+      {"Mf", "Mb", CorrelationTask::SCALAR_PRODUCT}
+  };
+  if( rnd_partitions == 0 )
+    correlations.push_back({"R1", "R2", CorrelationTask::Q1Q1_EVENT_PLANE});
+  for( int k=0; k<rnd_partitions; ++k )
+    correlations.push_back({"R1_" + std::to_string(k), "R2_" + std::to_string(k), CorrelationTask::Q1Q1_EVENT_PLANE});
+  // All correlations are registered before Run(), which reads every Q-vector once
+  // per event for all of them, the events split into blocks over n_threads threads
+  HadesFlow::Correlator correlator(file, "tree");
+  correlator.SetNonZeroOnly(false);
+  // Declared OBSERVABLE in correct, all other Q-vectors are references
+  correlator.SetObservable("u");
+  correlator.SetBootstrap(n_samples, bootstrap_seed);
+  for( const auto& correlation : correlations )
+    correlator.AddCorrelation(correlation.first, correlation.second, GetProduct(correlation.type));
 
   auto start = std::chrono::system_clock::now();
-  st.Run();
+  {
+    HadesFlow::ScopedStage stage("event loop");
+    correlator.Run(std::max(1u, n_threads));
+    correlator.Write(output);
+  }
   auto end = std::chrono::system_clock::now();
   std::chrono::duration<double> elapsed_seconds = end - start;
   std::cout << "elapsed time: " << elapsed_seconds.count() << " s\n";
+  if( vm.count("correlation-task") ){
+    HadesFlow::ScopedStage stage("correlation task");
+    CorrelationTask st(file, "tree");
+    st.SetNonZeroOnly(false);
+    for( const auto& correlation : correlations )
+      st.AddQ1Q1Correlation(correlation.first, correlation.second, correlation.type);
+    st.Run();
+  }
+  if( !perf_json.empty() ){
+    HadesFlow::CountEvents({file}, "tree");
+    HadesFlow::Perf::Get().WriteJson(perf_json);
+  }
   return 0;
 }
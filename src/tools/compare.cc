@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <boost/program_options.hpp>
+
+#include <TClass.h>
+#include <TFile.h>
+#include <TH1.h>
+#include <THnD.h>
+#include <TKey.h>
+
+// Compares the histograms (TH1 and THn) of a file with those of a reference file bin by bin,
+// e.g. the correlations of a benchmark run with those of an earlier build. Exits
+// with 1 if a histogram is missing, binned differently or differs by more than the
+// tolerance relative to the larger of the two values.
+
+namespace {
+
+bool Close(double first, double second, double tolerance) {
+  if( std::isnan(first) || std::isnan(second) )
+    return std::isnan(first) && std::isnan(second);
+  return std::abs(first - second) <= tolerance * std::max({std::abs(first), std::abs(second), 1e-300});
+}
+
+long long NumberOfBins(const TH1* histogram) { return histogram->GetNcells(); }
+long long NumberOfBins(const THnBase* histogram) { return histogram->GetNbins(); }
+
+template<typename Histogram, typename Report>
+void CompareBins(const Histogram* first, const Histogram* second, const std::string& name, double tolerance,
+                 Report& report) {
+  if( !first || !second || NumberOfBins(first) != NumberOfBins(second) ){
+    report(name, "different binning");
+    return;
+  }
+  for( long long bin=0; bin<NumberOfBins(first); ++bin ){
+    if( !Close(first->GetBinContent(bin), second->GetBinContent(bin), tolerance) ||
+        !Close(first->GetBinError(bin), second->GetBinError(bin), tolerance) ){
+      report(name, "bin " + std::to_string(bin) + " is " + std::to_string(second->GetBinContent(bin)) +
+                   " +- " + std::to_string(second->GetBinError(bin)) + " instead of " +
+                   std::to_string(first->GetBinContent(bin)) + " +- " + std::to_string(first->GetBinError(bin)));
+      return;
+    }
+  }
+}
+
+// Returns the number of histograms that differ
+int CompareDirectory(TDirectory* reference, TDirectory* file, const std::string& path, double tolerance) {
+  int n_different = 0;
+  auto report = [&n_different, &path](const std::string& name, const std::string& what){
+    std::cout << path << name << ": " << what << std::endl;
+    ++n_different;
+  };
+  TIter next(reference->GetListOfKeys());
+  while( auto* key = dynamic_cast<TKey*>(next()) ){
+    std::string name = key->GetName();
+    auto* cl = TClass::GetClass(key->GetClassName());
+    if( !cl )
+      continue;
+    if( cl->InheritsFrom(TDirectory::Class()) ){
+      auto* other = file->GetDirectory(name.c_str());
+      if( !other )
+        report(name, "missing");
+      else
+        n_different += CompareDirectory(reference->GetDirectory(name.c_str()), other, path + name + "/", tolerance);
+      continue;
+    }
+    const bool is_thn = cl->InheritsFrom(THnBase::Class());
+    if( !is_thn && !cl->InheritsFrom(TH1::Class()) )
+      continue;
+    auto* other_key = file->GetKey(name.c_str());
+    if( !other_key ){
+      report(name, "missing");
+      continue;
+    }
+    std::unique_ptr<TObject> first{key->ReadObj()};
+    std::unique_ptr<TObject> second{other_key->ReadObj()};
+    if( is_thn )
+      CompareBins(dynamic_cast<THnBase*>(first.get()), dynamic_cast<THnBase*>(second.get()), name, tolerance, report);
+    else
+      CompareBins(dynamic_cast<TH1*>(first.get()), dynamic_cast<TH1*>(second.get()), name, tolerance, report);
+  }
+  return n_different;
+}
+
+std::unique_ptr<TFile> OpenFile(const std::string& path) {
+  std::unique_ptr<TFile> file{TFile::Open(path.c_str(), "read")};
+  if( !file || file->IsZombie() )
+    throw std::runtime_error("Cannot open " + path);
+  return file;
+}
+
+}
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+  if(argc < 2){
+    throw std::runtime_error("No arguments were provided. Use ./compare --help to get more information.");
+  }
+
+  std::string reference;
+  std::string file;
+  double tolerance;
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("reference", po::value<std::string>(&reference), "Reference file")
+      ("input", po::value<std::string>(&file), "File compared with the reference")
+      ("tolerance", po::value<double>(&tolerance)->default_value(1e-9),
+       "Largest relative difference of bin contents and errors");
+  po::positional_options_description positional;
+  positional.add("reference", 1).add("input", 1);
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+
+  auto first = OpenFile(reference);
+  auto second = OpenFile(file);
+  auto n_different = CompareDirectory(first.get(), second.get(), "", tolerance);
+  if( n_different > 0 ){
+    std::cout << n_different << " histograms of " << file << " differ from " << reference << std::endl;
+    return 1;
+  }
+  std::cout << file << " agrees with " << reference << std::endl;
+  return 0;
+}
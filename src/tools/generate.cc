@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <boost/program_options.hpp>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TVector3.h>
+
+#include <AnalysisTree/Configuration.hpp>
+#include <AnalysisTree/DataHeader.hpp>
+#include <AnalysisTree/Detector.hpp>
+#include <AnalysisTree/EventHeader.hpp>
+#include <AnalysisTree/Matching.hpp>
+
+// Writes hades_analysis_tree files with the branches read by correct, mc_correct
+// and correlate. Events are generated with a known reaction plane and v1(y), v2 of
+// the participants and a directed flow of the spectators seen by the Forward Wall,
+// so the flow extracted from the files can be compared with the input.
+
+namespace {
+
+constexpr double kProtonMass = 0.938272;
+constexpr double kPionMass = 0.139570;
+constexpr int kProtonPid = 14;
+constexpr int kPiPlusPid = 8;
+constexpr int kPiMinusPid = 9;
+constexpr double kMaxImpact = 10.0;   // fm, up to ~50% centrality
+constexpr double kGeometricImpact = 14.0;
+constexpr double kWallDistance = 6950.0;   // mm
+
+struct Model {
+  double beam_rapidity;   // midrapidity in the lab
+  double v1_slope;        // v1 = v1_slope * y_cm
+  double v2;
+  double spectator_v1;
+};
+
+struct Particle {
+  int pid;
+  double mass;
+  double pT;
+  double phi;
+  double y_lab;
+  bool is_primary;
+};
+
+class EventGenerator {
+ public:
+  EventGenerator(const Model& model, unsigned long seed) : model_(model), random_(seed) {}
+
+  double Uniform(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(random_); }
+  double Gauss(double mean, double sigma) { return std::normal_distribution<double>(mean, sigma)(random_); }
+  int Poisson(double mean) { return mean > 0 ? std::poisson_distribution<int>(mean)(random_) : 0; }
+  bool Accept(double probability) { return Uniform(0.0, 1.0) < probability; }
+
+  // Azimuth relative to the reaction plane from 1 + 2 v1 cos(phi) + 2 v2 cos(2 phi)
+  double Phi(double psi, double v1, double v2) {
+    const double max = 1 + 2*std::abs(v1) + 2*std::abs(v2);
+    while( true ){
+      auto phi = Uniform(-M_PI, M_PI);
+      if( Uniform(0.0, max) < 1 + 2*v1*std::cos(phi) + 2*v2*std::cos(2*phi) )
+        return std::remainder(phi + psi, 2*M_PI);
+    }
+  }
+
+  // Thermal-like pT spectrum pT exp(-(mT - m) / T) up to 2 GeV/c, mean ~0.4 GeV/c for
+  // protons. Accepted relative to its maximum at pT^2 = T mT.
+  double Pt(double mass, double temperature) {
+    auto density = [mass, temperature](double pT){
+      auto mT = std::sqrt(pT*pT + mass*mass);
+      return pT * std::exp(-(mT - mass) / temperature);
+    };
+    const double t = temperature;
+    const double peak = std::sqrt((t*t + t*std::sqrt(t*t + 4*mass*mass)) / 2);
+    const double max = density(std::min(peak, 2.0));
+    while( true ){
+      auto pT = Uniform(0.0, 2.0);
+      if( Uniform(0.0, max) < density(pT) )
+        return pT;
+    }
+  }
+
+  Particle Participant(int pid, double mass, double psi, double temperature) {
+    Particle particle{pid, mass, Pt(mass, temperature), 0.0, 0.0, true};
+    auto y_cm = Gauss(0.0, 0.45);
+    particle.y_lab = y_cm + model_.beam_rapidity;
+    auto v1 = std::clamp(model_.v1_slope * y_cm, -0.45, 0.45);
+    particle.phi = Phi(psi, v1, model_.v2);
+    return particle;
+  }
+
+ private:
+  Model model_;
+  std::mt19937_64 random_;
+};
+
+double Theta(double mass, double pT, double y) {
+  auto mT = std::sqrt(pT*pT + mass*mass);
+  return std::atan2(pT, mT * std::sinh(y));
+}
+
+void SetMomentum(AnalysisTree::Track& track, double mass, double pT, double phi, double y) {
+  auto mT = std::sqrt(pT*pT + mass*mass);
+  track.SetMomentum(pT*std::cos(phi), pT*std::sin(phi), mT*std::sinh(y));
+}
+
+}
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+  if(argc < 2){
+    throw std::runtime_error("No arguments were provided. Use ./generate --help to get more information.");
+  }
+
+  std::string output;
+  std::string system;
+  long long n_events;
+  unsigned long seed;
+  Model model{};
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("output,o", po::value<std::string>(&output)->default_value("synthetic.root"), "Output file")
+      ("events,n", po::value<long long>(&n_events)->default_value(10000), "Number of events")
+      ("seed,s", po::value<unsigned long>(&seed)->default_value(1), "Random seed, files with equal seeds are identical")
+      ("system", po::value<std::string>(&system)->default_value("synthetic"),
+       "System in the DataHeader; correct applies the HadesUtils cuts for Au+Au and Ag+Ag only")
+      ("beam-rapidity", po::value<double>(&model.beam_rapidity)->default_value(0.74), "Midrapidity in the lab")
+      ("v1-slope", po::value<double>(&model.v1_slope)->default_value(0.4), "Slope dv1/dy of the participants")
+      ("v2", po::value<double>(&model.v2)->default_value(-0.06), "Elliptic flow of the participants")
+      ("spectator-v1", po::value<double>(&model.spectator_v1)->default_value(0.3),
+       "Directed flow of the spectators in the Forward Wall");
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, options), vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+
+  using AnalysisTree::BranchConfig;
+  using AnalysisTree::DetType;
+  // Event and track quality fields take values that pass the standard selection
+  BranchConfig event_config("event_header", DetType::kEventHeader);
+  event_config.AddField<int>("selected_tof_rpc_hits");
+  event_config.AddField<float>("selected_tof_rpc_hits_centrality");
+  event_config.AddField<float>("vtx_chi2");
+  const std::vector<std::string> event_flags{"good_vertex_cluster", "good_vertex_candidate", "good_start",
+                                             "no_pile_up_start", "good_start_veto", "good_start_meta", "no_veto"};
+  for( const auto& flag : event_flags )
+    event_config.AddField<int>(flag);
+  BranchConfig vtx_config("mdc_vtx_tracks", DetType::kTrack);
+  vtx_config.AddField<float>("rapidity");
+  vtx_config.AddField<int>("geant_pid");
+  vtx_config.AddField<float>("chi2");
+  vtx_config.AddField<float>("dca_xy");
+  vtx_config.AddField<float>("dca_z");
+  BranchConfig meta_config("meta_hits", DetType::kHit);
+  meta_config.AddField<float>("match_quality");
+  meta_config.AddField<float>("beta");
+  meta_config.AddField<float>("mass2");
+  meta_config.AddField<int>("charge");
+  BranchConfig wall_config("forward_wall_hits", DetType::kHit);
+  wall_config.AddField<int>("ring");
+  wall_config.AddField<float>("beta");
+  wall_config.AddField<int>("rnd_sub");
+  BranchConfig sim_event_config("sim_header", DetType::kEventHeader);
+  sim_event_config.AddField<float>("reaction_plane");
+  sim_event_config.AddField<float>("impact_parameter");
+  BranchConfig sim_config("sim_tracks", DetType::kTrack);
+  sim_config.AddField<float>("rapidity");
+  sim_config.AddField<int>("geant_pid");
+  sim_config.AddField<int>("is_primary");
+
+  AnalysisTree::Configuration config;
+  for( const auto* branch : {&event_config, &vtx_config, &meta_config, &wall_config, &sim_event_config, &sim_config} )
+    config.AddBranchConfig(*branch);
+
+  auto* event_header = new AnalysisTree::EventHeader(event_config.GetId());
+  auto* vtx_tracks = new AnalysisTree::TrackDetector(vtx_config.GetId());
+  auto* meta_hits = new AnalysisTree::HitDetector(meta_config.GetId());
+  auto* wall_hits = new AnalysisTree::HitDetector(wall_config.GetId());
+  auto* sim_header = new AnalysisTree::EventHeader(sim_event_config.GetId());
+  auto* sim_tracks = new AnalysisTree::TrackDetector(sim_config.GetId());
+  auto* vtx2sim = new AnalysisTree::Matching(vtx_config.GetId(), sim_config.GetId());
+  auto* vtx2meta = new AnalysisTree::Matching(vtx_config.GetId(), meta_config.GetId());
+  config.AddMatch(vtx2sim);
+  config.AddMatch(vtx2meta);
+  event_header->Init(event_config);
+  sim_header->Init(sim_event_config);
+
+  std::unique_ptr<TFile> file{TFile::Open(output.c_str(), "recreate")};
+  if( !file || file->IsZombie() )
+    throw std::runtime_error("Cannot create " + output);
+  auto* tree = new TTree("hades_analysis_tree", "Synthetic HADES events");
+  tree->Branch("event_header", &event_header);
+  tree->Branch("mdc_vtx_tracks", &vtx_tracks);
+  tree->Branch("meta_hits", &meta_hits);
+  tree->Branch("forward_wall_hits", &wall_hits);
+  tree->Branch("sim_header", &sim_header);
+  tree->Branch("sim_tracks", &sim_tracks);
+  tree->Branch(config.GetMatchName("mdc_vtx_tracks", "sim_tracks").c_str(), &vtx2sim);
+  tree->Branch(config.GetMatchName("mdc_vtx_tracks", "meta_hits").c_str(), &vtx2meta);
+
+  const auto hits_id = event_config.GetFieldId("selected_tof_rpc_hits");
+  const auto centrality_id = event_config.GetFieldId("selected_tof_rpc_hits_centrality");
+  const auto vtx_chi2_id = event_config.GetFieldId("vtx_chi2");
+  const auto psi_id = sim_event_config.GetFieldId("reaction_plane");
+  const auto b_id = sim_event_config.GetFieldId("impact_parameter");
+  const auto vtx_y_id = vtx_config.GetFieldId("rapidity");
+  const auto vtx_pid_id = vtx_config.GetFieldId("geant_pid");
+  const auto chi2_id = vtx_config.GetFieldId("chi2");
+  const auto dca_xy_id = vtx_config.GetFieldId("dca_xy");
+  const auto dca_z_id = vtx_config.GetFieldId("dca_z");
+  const auto quality_id = meta_config.GetFieldId("match_quality");
+  const auto meta_beta_id = meta_config.GetFieldId("beta");
+  const auto mass2_id = meta_config.GetFieldId("mass2");
+  const auto charge_id = meta_config.GetFieldId("charge");
+  const auto ring_id = wall_config.GetFieldId("ring");
+  const auto wall_beta_id = wall_config.GetFieldId("beta");
+  const auto rnd_sub_id = wall_config.GetFieldId("rnd_sub");
+  const auto sim_y_id = sim_config.GetFieldId("rapidity");
+  const auto sim_pid_id = sim_config.GetFieldId("geant_pid");
+  const auto primary_id = sim_config.GetFieldId("is_primary");
+
+  EventGenerator generator(model, seed);
+  std::vector<Particle> particles;
+  for( long long event=0; event<n_events; ++event ){
+    vtx_tracks->ClearChannels();
+    meta_hits->ClearChannels();
+    wall_hits->ClearChannels();
+    sim_tracks->ClearChannels();
+    vtx2sim->Clear();
+    vtx2meta->Clear();
+
+    // Impact parameter distributed as b db
+    auto b = kMaxImpact * std::sqrt(generator.Uniform(0.0, 1.0));
+    auto participation = 1.0 - b / kGeometricImpact;
+    auto psi = generator.Uniform(-M_PI, M_PI);
+    sim_header->SetField(float(psi), psi_id);
+    sim_header->SetField(float(b), b_id);
+
+    particles.clear();
+    for( int i=0, n=generator.Poisson(110 * std::pow(participation, 1.3)); i<n; ++i )
+      particles.push_back(generator.Participant(kProtonPid, kProtonMass, psi, 0.09));
+    for( int i=0, n=generator.Poisson(8 * participation); i<n; ++i ){
+      auto pid = generator.Accept(0.5) ? kPiPlusPid : kPiMinusPid;
+      particles.push_back(generator.Participant(pid, kPionMass, psi, 0.07));
+    }
+    // Secondary protons, e.g. knocked out of the target, without flow
+    for( int i=0, n=generator.Poisson(5); i<n; ++i ){
+      auto particle = generator.Participant(kProtonPid, kProtonMass, generator.Uniform(-M_PI, M_PI), 0.05);
+      particle.is_primary = false;
+      particles.push_back(particle);
+    }
+
+    int tof_rpc_hits = 0;
+    for( size_t i=0; i<particles.size(); ++i ){
+      const auto& particle = particles[i];
+      auto& sim_track = sim_tracks->AddChannel();
+      sim_track.Init(sim_config);
+      SetMomentum(sim_track, particle.mass, particle.pT, particle.phi, particle.y_lab);
+      sim_track.SetField(float(particle.y_lab), sim_y_id);
+      sim_track.SetField(particle.pid, sim_pid_id);
+      sim_track.SetField(int(particle.is_primary), primary_id);
+
+      // MDC acceptance 18-85 degrees, momentum dependent efficiency
+      auto theta = Theta(particle.mass, particle.pT, particle.y_lab) * 180.0 / M_PI;
+      if( theta < 18.0 || theta > 85.0 )
+        continue;
+      ++tof_rpc_hits;
+      if( !generator.Accept(0.9 * (1.0 - std::exp(-particle.pT / 0.15))) )
+        continue;
+      auto pT = particle.pT * generator.Gauss(1.0, 0.02);
+      auto y = particle.y_lab + generator.Gauss(0.0, 0.01);
+      auto& track = vtx_tracks->AddChannel();
+      track.Init(vtx_config);
+      SetMomentum(track, particle.mass, pT, particle.phi + generator.Gauss(0.0, 0.005), y);
+      track.SetField(float(y), vtx_y_id);
+      track.SetField(particle.pid, vtx_pid_id);
+      track.SetField(float(generator.Uniform(0.5, 40.0)), chi2_id);
+      track.SetField(float(generator.Gauss(0.0, 2.0)), dca_xy_id);
+      track.SetField(float(generator.Gauss(0.0, 2.0)), dca_z_id);
+
+      auto mT = std::sqrt(pT*pT + particle.mass*particle.mass);
+      auto p = std::hypot(pT, mT * std::sinh(y));
+      auto& hit = meta_hits->AddChannel();
+      hit.Init(meta_config);
+      hit.SetField(float(std::abs(generator.Gauss(0.0, 1.0))), quality_id);
+      hit.SetField(float(p / std::hypot(p, particle.mass)), meta_beta_id);
+      hit.SetField(float(particle.mass * particle.mass * generator.Gauss(1.0, 0.05)), mass2_id);
+      hit.SetField(particle.pid == kPiMinusPid ? -1 : 1, charge_id);
+      vtx2sim->AddMatch(int(track.GetId()), int(sim_track.GetId()));
+      vtx2meta->AddMatch(int(track.GetId()), int(hit.GetId()));
+    }
+    // Charged particles outside the MDC selection and noise
+    tof_rpc_hits += generator.Poisson(0.3 * tof_rpc_hits + 3);
+    event_header->SetField(tof_rpc_hits, hits_id);
+    auto centrality = 100.0 * b*b / (kGeometricImpact*kGeometricImpact) + generator.Gauss(0.0, 2.0);
+    event_header->SetField(float(std::clamp(centrality, 0.0, 100.0)), centrality_id);
+    event_header->SetVertexPosition3(TVector3(generator.Gauss(0.0, 0.5), generator.Gauss(0.0, 0.5),
+                                              generator.Uniform(-60.0, 0.0)));
+    event_header->SetField(float(generator.Uniform(0.5, 10.0)), vtx_chi2_id);
+    for( const auto& flag : event_flags )
+      event_header->SetField(1, event_config.GetFieldId(flag));
+
+    // Spectator fragments near beam rapidity, deflected along the reaction plane
+    for( int i=0, n=generator.Poisson(40 * b / kGeometricImpact); i<n; ++i ){
+      auto phi = generator.Phi(psi, model.spectator_v1, 0.0);
+      auto theta = std::abs(generator.Gauss(0.0, 0.05));
+      auto r = kWallDistance * std::tan(theta);
+      auto charge = generator.Accept(0.6) ? 1 : generator.Accept(0.75) ? 2 : 3;
+      auto& hit = wall_hits->AddChannel();
+      hit.Init(wall_config);
+      hit.SetPosition(r*std::cos(phi), r*std::sin(phi), kWallDistance);
+      hit.SetSignal(float(100.0 * charge*charge * generator.Gauss(1.0, 0.1)));
+      hit.SetField(std::clamp(1 + int(r / 90.0), 1, 10), ring_id);
+      hit.SetField(float(std::min(1.0, generator.Gauss(0.93, 0.03))), wall_beta_id);
+      hit.SetField(int(generator.Accept(0.5)), rnd_sub_id);
+    }
+    // Slow particles and noise, removed by the beta and signal cuts
+    for( int i=0, n=generator.Poisson(5); i<n; ++i ){
+      auto phi = generator.Uniform(-M_PI, M_PI);
+      auto r = generator.Uniform(0.0, 900.0);
+      auto& hit = wall_hits->AddChannel();
+      hit.Init(wall_config);
+      hit.SetPosition(r*std::cos(phi), r*std::sin(phi), kWallDistance);
+      hit.SetSignal(float(generator.Uniform(0.0, 80.0)));
+      hit.SetField(std::clamp(1 + int(r / 90.0), 1, 10), ring_id);
+      hit.SetField(float(generator.Uniform(0.2, 0.8)), wall_beta_id);
+      hit.SetField(int(generator.Accept(0.5)), rnd_sub_id);
+    }
+    tree->Fill();
+  }
+
+  AnalysisTree::DataHeader data_header;
+  data_header.SetSystem(system);
+  data_header.SetBeamRapidity(model.beam_rapidity);
+  file->cd();
+  config.Write("Configuration");
+  data_header.Write("DataHeader");
+  tree->Write();
+  file->Close();
+  std::cout << "Wrote " << n_events << " events to " << output << " (seed " << seed
+            << ", v1 = " << model.v1_slope << " * y_cm, v2 = " << model.v2 << ")" << std::endl;
+  return 0;
+}
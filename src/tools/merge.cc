@@ -0,0 +1,60 @@
+#include <iostream>
+#include <boost/program_options.hpp>
+
+#include <sys/stat.h>
+
+#include <common/file_list.h>
+#include <common/merge.h>
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+  if(argc < 2){
+    throw std::runtime_error("No arguments were provided. Use ./merge --help to get more information.");
+  }
+
+  std::vector<std::string> inputs;
+  std::vector<std::string> skip;
+  std::string input_list;
+  std::string output;
+  std::string file_name;
+  std::string work_dir;
+  int n_workers;
+  int fan_in;
+  po::options_description options("Options");
+  options.add_options()
+      ("help,h", "Help screen")
+      ("input", po::value<std::vector<std::string>>(&inputs), "Files or job directories to merge")
+      ("list,l", po::value<std::string>(&input_list), "File with one input file or job directory per line")
+      ("output,o", po::value<std::string>(&output)->default_value("merged.root"), "Output file")
+      ("name,n", po::value<std::string>(&file_name)->default_value("correction_in.root"),
+       "File to take from each job directory")
+      ("threads,t", po::value<int>(&n_workers)->default_value(1), "Number of parallel merge workers")
+      ("fan-in,f", po::value<int>(&fan_in)->default_value(16),
+       "Number of files merged at once by a worker, bounds the memory per worker")
+      ("work-dir", po::value<std::string>(&work_dir)->default_value("merge_tmp"),
+       "Directory for the intermediate files")
+      ("skip,s", po::value<std::vector<std::string>>(&skip),
+       "Object to leave out, e.g. \"tree\" to merge only the correction histograms");
+  po::positional_options_description positional;
+  positional.add("input", -1);
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+  po::notify(vm);
+  if (vm.count("help")){
+    std::cout << options << std::endl;
+    return 0;
+  }
+  if( !input_list.empty() ){
+    auto listed = HadesFlow::ReadFileList(input_list);
+    inputs.insert(inputs.end(), listed.begin(), listed.end());
+  }
+  for( auto& input : inputs ){
+    struct stat info{};
+    if( stat(input.c_str(), &info) == 0 && S_ISDIR(info.st_mode) )
+      input += "/" + file_name;
+  }
+
+  HadesFlow::TreeMerge(inputs, output, fan_in, n_workers, work_dir, skip);
+  std::cout << "Merged " << inputs.size() << " files into " << output << std::endl;
+  return 0;
+}